@@ -0,0 +1,69 @@
+#include "../Include/DownloadSorter/AdaptiveConcurrency.h"
+
+#include <algorithm>
+
+namespace {
+// A window holds at least this many operations, and two per slot
+constexpr int minWindowOps = 8;
+// Cost per unit this far above the best seen counts as congestion
+constexpr double congestedCost = 1.5;
+// Throughput changes smaller than these count as noise
+constexpr double keptUp = 0.95;
+constexpr double fellBack = 0.9;
+}  // namespace
+
+AdaptiveConcurrency::AdaptiveConcurrency(int initial, int minimum, int maximum)
+    : floor(std::max(1, minimum)),
+      ceiling(std::max(std::max(1, minimum), maximum)) {
+    this->current = std::clamp(initial, this->floor, this->ceiling);
+}
+
+void AdaptiveConcurrency::acquire() {
+    QMutexLocker lock(&this->mutex);
+    while (this->running >= this->current)
+        this->slotFree.wait(&this->mutex);
+    if (!this->window.isValid())
+        this->window.start();
+    this->running++;
+}
+
+void AdaptiveConcurrency::release(qint64 nanoseconds, qint64 units) {
+    QMutexLocker lock(&this->mutex);
+    this->running--;
+    if (units > 0) {
+        this->windowOps++;
+        this->windowUnits += units;
+        this->windowNs += std::max<qint64>(nanoseconds, 1);
+        if (this->windowOps >= std::max(minWindowOps, 2 * this->current))
+            this->adjust();
+    }
+    this->slotFree.wakeAll();
+}
+
+int AdaptiveConcurrency::limit() const {
+    QMutexLocker lock(&this->mutex);
+    return this->current;
+}
+
+void AdaptiveConcurrency::adjust() {
+    const double elapsed = std::max<qint64>(this->window.nsecsElapsed(), 1);
+    const double throughput = this->windowUnits / elapsed;
+    const double cost = double(this->windowNs) / this->windowUnits;
+    if (this->bestCost == 0 || cost < this->bestCost)
+        this->bestCost = cost;
+
+    const bool congested = cost > this->bestCost * congestedCost;
+    if (throughput < this->lastThroughput * fellBack || congested) {
+        // Multiplicative decrease
+        this->current = std::max(this->floor, this->current / 2);
+    } else if (throughput >= this->lastThroughput * keptUp) {
+        // Additive increase
+        this->current = std::min(this->ceiling, this->current + 1);
+    }
+
+    this->lastThroughput = throughput;
+    this->windowOps = 0;
+    this->windowUnits = 0;
+    this->windowNs = 0;
+    this->window.restart();
+}
@@ -0,0 +1,492 @@
+#include "../Include/DownloadSorter/ArchiveExtractor.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QProcess>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QStorageInfo>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtCore/QtEndian>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#ifdef DOWNLOADSORTER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+// Read/inflate chunk per entry
+constexpr qint64 chunkSize = 256 * 1024;
+// Left free on the target volume after unpacking
+constexpr qint64 spaceMargin = 64LL * 1024 * 1024;
+// Unpacked size is unknown without listing the archive; assume this much
+// growth for formats handed to an external tool
+constexpr qint64 toolExpansionGuess = 2;
+
+const QStringList archiveSuffixes = {"zip", "7z",  "rar", "tar", "gz",
+                                     "tgz", "bz2", "xz",  "tbz2", "txz"};
+
+struct ZipEntry {
+    QString name;
+    quint16 flags = 0;
+    quint16 method = 0;
+    quint16 dosTime = 0;
+    quint16 dosDate = 0;
+    quint32 crc = 0;
+    qint64 compressedSize = 0;
+    qint64 size = 0;
+    qint64 localHeaderOffset = 0;
+
+    bool isDir() const { return this->name.endsWith('/'); }
+};
+
+#ifdef DOWNLOADSORTER_HAVE_ZLIB
+quint16 le16(const char* p) {
+    return qFromLittleEndian<quint16>(p);
+}
+quint32 le32(const char* p) {
+    return qFromLittleEndian<quint32>(p);
+}
+quint64 le64(const char* p) {
+    return qFromLittleEndian<quint64>(p);
+}
+
+QDateTime fromDosTime(quint16 date, quint16 time) {
+    return QDateTime(QDate(((date >> 9) & 0x7f) + 1980, (date >> 5) & 0x0f,
+                           date & 0x1f),
+                     QTime(time >> 11, (time >> 5) & 0x3f, (time & 0x1f) * 2));
+}
+
+// Entry names are untrusted: nothing absolute and nothing climbing out
+bool isSafeName(const QString& name) {
+    if (name.isEmpty() || name.startsWith('/') ||
+        (name.size() > 1 && name.at(1) == ':'))
+        return false;
+    for (const QString& part : name.split('/')) {
+        if (part == QLatin1String(".."))
+            return false;
+    }
+    return true;
+}
+
+// Reads the central directory. False if the file is not a ZIP or uses
+// something this reader does not handle (spanning, encryption, methods
+// other than store and deflate); the caller then falls back to a tool.
+bool readCentralDirectory(QFile& file, QVector<ZipEntry>* entries) {
+    const qint64 fileSize = file.size();
+    // End record (22 bytes) plus the longest possible comment
+    const qint64 tailSize = qMin<qint64>(fileSize, 22 + 0xffff);
+    if (tailSize < 22 || !file.seek(fileSize - tailSize))
+        return false;
+    const QByteArray tail = file.read(tailSize);
+    qsizetype eocd = -1;
+    for (qsizetype i = tail.size() - 22; i >= 0; --i) {
+        if (le32(tail.constData() + i) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0)
+        return false;
+
+    const char* e = tail.constData() + eocd;
+    if (le16(e + 4) != 0 || le16(e + 6) != 0)
+        return false;  // multi-disk
+    quint64 count = le16(e + 10);
+    quint64 cdSize = le32(e + 12);
+    quint64 cdOffset = le32(e + 16);
+
+    // ZIP64: the real numbers are in a second end record
+    if (count == 0xffff || cdSize == 0xffffffff || cdOffset == 0xffffffff) {
+        const qint64 locator = fileSize - tailSize + eocd - 20;
+        if (locator < 0 || !file.seek(locator))
+            return false;
+        const QByteArray loc = file.read(20);
+        if (loc.size() != 20 || le32(loc.constData()) != 0x07064b50 ||
+            !file.seek(static_cast<qint64>(le64(loc.constData() + 8))))
+            return false;
+        const QByteArray rec = file.read(56);
+        if (rec.size() != 56 || le32(rec.constData()) != 0x06064b50)
+            return false;
+        count = le64(rec.constData() + 32);
+        cdSize = le64(rec.constData() + 40);
+        cdOffset = le64(rec.constData() + 48);
+    }
+    if (cdOffset + cdSize > static_cast<quint64>(fileSize) ||
+        !file.seek(static_cast<qint64>(cdOffset)))
+        return false;
+
+    const QByteArray cd = file.read(static_cast<qint64>(cdSize));
+    if (cd.size() != static_cast<qsizetype>(cdSize))
+        return false;
+    entries->reserve(static_cast<qsizetype>(qMin<quint64>(count, 1 << 20)));
+
+    qsizetype pos = 0;
+    for (quint64 i = 0; i < count; ++i) {
+        if (pos + 46 > cd.size())
+            return false;
+        const char* h = cd.constData() + pos;
+        if (le32(h) != 0x02014b50)
+            return false;
+        ZipEntry entry;
+        entry.flags = le16(h + 8);
+        entry.method = le16(h + 10);
+        entry.dosTime = le16(h + 12);
+        entry.dosDate = le16(h + 14);
+        entry.crc = le32(h + 16);
+        quint64 compressed = le32(h + 20);
+        quint64 size = le32(h + 24);
+        quint64 offset = le32(h + 42);
+        const quint16 nameLength = le16(h + 28);
+        const quint16 extraLength = le16(h + 30);
+        const quint16 commentLength = le16(h + 32);
+        if (pos + 46 + nameLength + extraLength + commentLength > cd.size())
+            return false;
+
+        const QByteArray rawName(h + 46, nameLength);
+        // Bit 11: UTF-8 names; older tools used the DOS code page
+        entry.name = (entry.flags & 0x800) ? QString::fromUtf8(rawName)
+                                           : QString::fromLatin1(rawName);
+        entry.name.replace('\\', '/');
+
+        // ZIP64 extra field: only the values that overflowed, in order
+        const char* extra = h + 46 + nameLength;
+        for (int x = 0; x + 4 <= extraLength;) {
+            const quint16 id = le16(extra + x);
+            const quint16 length = le16(extra + x + 2);
+            if (id == 0x0001) {
+                const char* v = extra + x + 4;
+                const char* end =
+                    extra + qMin(x + 4 + length, int(extraLength));
+                if (size == 0xffffffff && v + 8 <= end) {
+                    size = le64(v);
+                    v += 8;
+                }
+                if (compressed == 0xffffffff && v + 8 <= end) {
+                    compressed = le64(v);
+                    v += 8;
+                }
+                if (offset == 0xffffffff && v + 8 <= end)
+                    offset = le64(v);
+            }
+            x += 4 + length;
+        }
+        entry.compressedSize = static_cast<qint64>(compressed);
+        entry.size = static_cast<qint64>(size);
+        entry.localHeaderOffset = static_cast<qint64>(offset);
+
+        if ((entry.flags & 0x1) || (entry.method != 0 && entry.method != 8))
+            return false;  // encrypted or an unsupported method
+        entries->append(entry);
+        pos += 46 + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+// Stream one entry out of the archive; its own file handle lets entries of
+// the same archive run side by side
+bool extractEntry(const QString& archive,
+                  const ZipEntry& entry,
+                  const QString& target,
+                  std::atomic<qint64>& written) {
+    QFile in(archive);
+    if (!in.open(QIODevice::ReadOnly) || !in.seek(entry.localHeaderOffset))
+        return false;
+    const QByteArray local = in.read(30);
+    if (local.size() != 30 || le32(local.constData()) != 0x04034b50)
+        return false;
+    const qint64 dataStart = entry.localHeaderOffset + 30 +
+                             le16(local.constData() + 26) +
+                             le16(local.constData() + 28);
+    if (!in.seek(dataStart))
+        return false;
+
+    // Written to a temporary name and renamed into place when complete
+    QSaveFile out(target);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    qint64 produced = 0;
+    qint64 remaining = entry.compressedSize;
+    std::vector<char> input(chunkSize);
+    bool ok = true;
+
+    if (entry.method == 0) {
+        while (ok && remaining > 0) {
+            const qint64 n = in.read(input.data(), qMin(remaining, chunkSize));
+            if (n <= 0 || produced + n > entry.size) {
+                ok = false;
+                break;
+            }
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(input.data()),
+                        static_cast<uInt>(n));
+            ok = out.write(input.data(), n) == n;
+            produced += n;
+            remaining -= n;
+        }
+    } else {
+        z_stream zs = {};
+        if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+            return false;
+        std::vector<char> output(chunkSize);
+        int status = Z_OK;
+        while (ok && status != Z_STREAM_END) {
+            if (zs.avail_in == 0) {
+                const qint64 n =
+                    in.read(input.data(), qMin(remaining, chunkSize));
+                if (n <= 0) {
+                    ok = false;
+                    break;
+                }
+                remaining -= n;
+                zs.next_in = reinterpret_cast<Bytef*>(input.data());
+                zs.avail_in = static_cast<uInt>(n);
+            }
+            zs.next_out = reinterpret_cast<Bytef*>(output.data());
+            zs.avail_out = static_cast<uInt>(output.size());
+            status = inflate(&zs, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END) {
+                ok = false;
+                break;
+            }
+            const qint64 n = static_cast<qint64>(output.size()) - zs.avail_out;
+            // The free space check went by the declared size; an entry that
+            // inflates past it is stopped before it can fill the disk
+            if (produced + n > entry.size) {
+                ok = false;
+                break;
+            }
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(output.data()),
+                        static_cast<uInt>(n));
+            ok = out.write(output.data(), n) == n;
+            produced += n;
+        }
+        inflateEnd(&zs);
+    }
+
+    if (!ok || produced != entry.size || crc != entry.crc) {
+        out.cancelWriting();
+        return false;
+    }
+    if (!out.commit())
+        return false;
+    written += produced;
+
+    QFile done(target);
+    if (done.open(QIODevice::Append))
+        done.setFileTime(fromDosTime(entry.dosDate, entry.dosTime),
+                         QFileDevice::FileModificationTime);
+    return true;
+}
+#endif
+
+// 7-Zip handles nearly everything; bsdtar covers the tar family and ZIP
+bool runTool(const QString& archive, const QString& destination) {
+    QString program;
+    QStringList arguments;
+    for (const char* name : {"7zz", "7z", "7za"}) {
+        program = QStandardPaths::findExecutable(QString::fromLatin1(name));
+        if (!program.isEmpty()) {
+            arguments = {"x", "-y", "-bd", "-o" + destination, archive};
+            break;
+        }
+    }
+    if (program.isEmpty()) {
+        program = QStandardPaths::findExecutable("bsdtar");
+        arguments = {"-x", "-f", archive, "-C", destination};
+    }
+    if (program.isEmpty())
+        return false;
+
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+    process.start(program, arguments);
+    if (!process.waitForFinished(-1) ||
+        process.exitStatus() != QProcess::NormalExit ||
+        process.exitCode() != 0) {
+        qWarning().noquote() << "Extracting" << archive << "failed:"
+                             << process.readAll().trimmed();
+        return false;
+    }
+    return true;
+}
+
+bool haveTool() {
+    for (const char* name : {"7zz", "7z", "7za", "bsdtar"}) {
+        if (!QStandardPaths::findExecutable(QString::fromLatin1(name))
+                 .isEmpty())
+            return true;
+    }
+    return false;
+}
+
+// "x.zip" -> "x", then "x (1)", ...; created right away so two archives
+// with the same base name never share a folder
+QString claimDestination(const QString& archive) {
+    const QFileInfo info(archive);
+    const QDir dir = info.dir();
+    QString base = info.completeBaseName();
+    if (base.endsWith(QLatin1String(".tar"), Qt::CaseInsensitive))
+        base.chop(4);
+    QString name = base;
+    for (int n = 1; dir.exists(name) || !dir.mkdir(name); ++n) {
+        if (n > 1000)
+            return QString();
+        name = QStringLiteral("%1 (%2)").arg(base).arg(n);
+    }
+    return dir.absoluteFilePath(name);
+}
+
+struct ArchiveJob {
+    QString archive;
+    QString destination;
+    std::atomic<bool> failed{false};
+};
+}  // namespace
+
+ArchiveExtractor::ArchiveExtractor(int maxThreads)
+    : maxThreads(qMax(1, maxThreads)) {}
+
+bool ArchiveExtractor::isArchive(const QString& path) {
+    return archiveSuffixes.contains(QFileInfo(path).suffix(),
+                                    Qt::CaseInsensitive);
+}
+
+ArchiveExtractor::Result ArchiveExtractor::extract(
+    const QStringList& archives,
+    const std::function<bool()>& cancelled) const {
+    Result result;
+    const bool toolAvailable = haveTool();
+    std::atomic<qint64> written{0};
+
+    // Work is planned here, then run in one pool: whole archives for the
+    // external tool, single entries for the built-in ZIP reader
+    struct Task {
+        ArchiveJob* job;
+        ZipEntry entry;  // empty name: run the tool on the whole archive
+        QString target;
+        qint64 weight;
+    };
+    std::deque<ArchiveJob> jobs;
+    std::vector<Task> tasks;
+    QHash<QString, qint64> reserved;  // volume root -> bytes promised
+
+    for (const QString& archive : archives) {
+        QVector<ZipEntry> entries;
+        bool native = false;
+#ifdef DOWNLOADSORTER_HAVE_ZLIB
+        if (QFileInfo(archive).suffix().compare("zip", Qt::CaseInsensitive) ==
+            0) {
+            QFile file(archive);
+            native = file.open(QIODevice::ReadOnly) &&
+                     readCentralDirectory(file, &entries);
+            for (const ZipEntry& entry : entries)
+                native = native && isSafeName(entry.name);
+        }
+#endif
+        if (!native && !toolAvailable) {
+            result.skipped++;
+            continue;
+        }
+
+        // Room for the unpacked size, counting what earlier archives in
+        // this batch will take from the same volume
+        qint64 needed = 0;
+        if (native) {
+            for (const ZipEntry& entry : entries)
+                needed += entry.size;
+        } else {
+            needed = QFileInfo(archive).size() * toolExpansionGuess;
+        }
+        const QStorageInfo volume(QFileInfo(archive).absolutePath());
+        qint64& promised = reserved[volume.rootPath()];
+        if (volume.bytesAvailable() - promised < needed + spaceMargin) {
+            qWarning() << "Not enough space to extract" << archive;
+            result.skipped++;
+            continue;
+        }
+
+        const QString destination = claimDestination(archive);
+        if (destination.isEmpty()) {
+            result.failed++;
+            continue;
+        }
+        promised += needed;
+
+        jobs.emplace_back();
+        ArchiveJob* job = &jobs.back();
+        job->archive = archive;
+        job->destination = destination;
+        if (!native) {
+            tasks.push_back({job, ZipEntry(), QString(),
+                             QFileInfo(archive).size()});
+            continue;
+        }
+
+        // Folders first, so file entries can be written in any order
+        const QDir root(destination);
+        for (const ZipEntry& entry : entries) {
+            const QString target = root.absoluteFilePath(entry.name);
+            if (entry.isDir()) {
+                root.mkpath(entry.name);
+                continue;
+            }
+            root.mkpath(QFileInfo(target).path());
+            tasks.push_back({job, entry, target, entry.compressedSize});
+        }
+    }
+
+    // Largest first, so one big entry does not start last and run alone
+    std::stable_sort(tasks.begin(), tasks.end(),
+                     [](const Task& a, const Task& b) {
+                         return a.weight > b.weight;
+                     });
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(this->maxThreads);
+    for (const Task& task : tasks) {
+        pool.start([&task, &cancelled, &written]() {
+            ArchiveJob* job = task.job;
+            if (job->failed || (cancelled && cancelled())) {
+                job->failed = true;
+                return;
+            }
+            bool ok = false;
+            if (task.entry.name.isEmpty()) {
+                ok = runTool(job->archive, job->destination);
+            } else {
+#ifdef DOWNLOADSORTER_HAVE_ZLIB
+                ok = extractEntry(job->archive, task.entry, task.target,
+                                  written);
+#else
+                Q_UNUSED(written);
+#endif
+            }
+            if (!ok)
+                job->failed = true;
+        });
+    }
+    pool.waitForDone();
+
+    for (ArchiveJob& job : jobs) {
+        if (job.failed) {
+            // Only ever a folder this run created
+            QDir(job.destination).removeRecursively();
+            result.failed++;
+        } else {
+            result.extracted++;
+        }
+    }
+    result.bytesWritten = written;
+    return result;
+}
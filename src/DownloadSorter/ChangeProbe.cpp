@@ -0,0 +1,119 @@
+#include "../Include/DownloadSorter/ChangeProbe.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#include <algorithm>
+
+#ifndef Q_OS_WIN
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+constexpr qint64 nsecsPerSec = 1000000000LL;
+
+// Same hash for a name on every call, whatever the process seed
+quint64 nameHash(const char* data, qsizetype size) {
+    // FNV-1a
+    quint64 hash = 14695981039346656037ULL;
+    for (qsizetype i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+}  // namespace
+
+ChangeProbe::ChangeProbe(const QString& root,
+                         bool digestNames,
+                         int minIntervalMs,
+                         int maxIntervalMs)
+    : root(root),
+      digestNames(digestNames),
+      minInterval(minIntervalMs),
+      maxInterval(std::max(minIntervalMs, maxIntervalMs)),
+      interval(minIntervalMs) {}
+
+bool ChangeProbe::Signature::operator==(const Signature& other) const {
+    return mtimeNs == other.mtimeNs && ctimeNs == other.ctimeNs &&
+           size == other.size && links == other.links &&
+           entries == other.entries && names == other.names &&
+           exists == other.exists;
+}
+
+ChangeProbe::Signature ChangeProbe::read() const {
+    Signature sig;
+    const QByteArray path = QFile::encodeName(this->root);
+#if defined(Q_OS_LINUX) && defined(STATX_BASIC_STATS)
+    // Force a fresh round trip: NFS would otherwise answer from its
+    // attribute cache for up to a minute
+    struct statx stx;
+    if (::statx(AT_FDCWD, path.constData(), AT_STATX_FORCE_SYNC,
+                STATX_MTIME | STATX_CTIME | STATX_SIZE | STATX_NLINK,
+                &stx) != 0)
+        return sig;
+    sig.mtimeNs = stx.stx_mtime.tv_sec * nsecsPerSec + stx.stx_mtime.tv_nsec;
+    sig.ctimeNs = stx.stx_ctime.tv_sec * nsecsPerSec + stx.stx_ctime.tv_nsec;
+    sig.size = static_cast<qint64>(stx.stx_size);
+    sig.links = stx.stx_nlink;
+#elif !defined(Q_OS_WIN)
+    struct stat st;
+    if (::stat(path.constData(), &st) != 0)
+        return sig;
+    sig.mtimeNs = st.st_mtime * nsecsPerSec;
+    sig.ctimeNs = st.st_ctime * nsecsPerSec;
+    sig.size = st.st_size;
+    sig.links = st.st_nlink;
+#else
+    const QFileInfo info(this->root);
+    if (!info.isDir())
+        return sig;
+    sig.mtimeNs = info.lastModified().toMSecsSinceEpoch() * 1000000;
+    sig.ctimeNs =
+        info.fileTime(QFileDevice::FileMetadataChangeTime).toMSecsSinceEpoch() *
+        1000000;
+#endif
+    sig.exists = true;
+
+    if (!this->digestNames)
+        return sig;
+
+    // Sum of per-name hashes: independent of the order readdir returns
+    sig.entries = 0;
+#ifndef Q_OS_WIN
+    DIR* dir = ::opendir(path.constData());
+    if (!dir)
+        return sig;
+    while (const dirent* d = ::readdir(dir)) {
+        const qsizetype length = qstrlen(d->d_name);
+        sig.names += nameHash(d->d_name, length);
+        sig.entries++;
+    }
+    ::closedir(dir);
+#else
+    for (const QString& name :
+         QDir(this->root).entryList(QDir::AllEntries | QDir::Hidden |
+                                        QDir::System | QDir::NoDotAndDotDot,
+                                    QDir::Unsorted)) {
+        const QByteArray utf8 = name.toUtf8();
+        sig.names += nameHash(utf8.constData(), utf8.size());
+        sig.entries++;
+    }
+#endif
+    return sig;
+}
+
+bool ChangeProbe::changed() {
+    const Signature now = this->read();
+    if (this->primed && now == this->last) {
+        this->interval = std::min(this->interval * 2, this->maxInterval);
+        return false;
+    }
+    this->primed = true;
+    this->last = now;
+    this->interval = this->minInterval;
+    return true;
+}
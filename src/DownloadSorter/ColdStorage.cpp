@@ -0,0 +1,347 @@
+#include "../Include/DownloadSorter/ColdStorage.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QtEndian>
+
+#include <atomic>
+#include <utility>
+
+#ifndef Q_OS_WIN
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+namespace {
+// Files are compressed in fixed-size chunks so large files are never held in
+// memory at once
+constexpr qint64 chunkSize = 1 << 20;
+// High bit of a chunk header marks a chunk stored as-is; already compressed
+// media gains nothing from another pass
+constexpr quint32 rawChunkFlag = 0x80000000u;
+constexpr quint32 indexMagic = 0x44534331;  // "DSC1"
+const QString indexFileName = QStringLiteral("index.bin");
+
+// Make sure what was written to `file` is on the disk, not just in the page
+// cache; the originals are deleted on the strength of it
+bool syncToDisk(QFile& file) {
+    if (!file.flush())
+        return false;
+#ifndef Q_OS_WIN
+    return ::fsync(file.handle()) == 0;
+#else
+    return ::_commit(file.handle()) == 0;
+#endif
+}
+}  // namespace
+
+ColdStorage::ColdStorage(const QString& categoryPath)
+    : categoryDir(categoryPath),
+      storeDir(QDir(categoryPath).filePath(storeDirName)) {
+    this->loadIndex();
+}
+
+QStringList ColdStorage::collectCandidates(int days) const {
+    QStringList candidates;
+    const QDateTime cutoff = QDateTime::currentDateTime().addDays(-days);
+    const QString storePath = this->storeDir.absolutePath() + "/";
+
+    QDirIterator it(this->categoryDir.absolutePath(),
+                    QDir::Files | QDir::Hidden | QDir::NoSymLinks,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        if (info.absoluteFilePath().startsWith(storePath))
+            continue;
+
+        // "Untouched" means neither read nor written since the cutoff
+        const QDateTime lastTouched =
+            qMax(info.lastModified(), info.lastRead());
+        if (lastTouched < cutoff)
+            candidates.append(
+                this->categoryDir.relativeFilePath(info.absoluteFilePath()));
+    }
+    return candidates;
+}
+
+ColdStorage::Result ColdStorage::archiveOlderThan(int days, int maxThreads) {
+    Result result;
+    if (days <= 0)
+        return result;
+
+    const QStringList candidates = this->collectCandidates(days);
+    if (candidates.isEmpty())
+        return result;
+    if (!this->categoryDir.mkpath(storeDirName))
+        return result;
+
+    const int workers = qBound(1, maxThreads, int(candidates.size()));
+    const QString stamp = QString::number(QDateTime::currentMSecsSinceEpoch());
+
+    std::atomic<qsizetype> next{0};
+    QMutex mutex;
+    QHash<QString, Entry> added;
+    QStringList packs;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workers);
+    pool.setThreadPriority(QThread::LowestPriority);
+
+    for (int w = 0; w < workers; ++w) {
+        const QString packName =
+            QStringLiteral("pack-%1-%2.dsz").arg(stamp).arg(w);
+        packs.append(packName);
+
+        pool.start([&, packName]() {
+            // Each worker owns its pack, so appends need no locking; its
+            // entries are only handed over once the pack is on disk
+            QFile pack(this->storeDir.filePath(packName));
+            if (!pack.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                return;
+            QHash<QString, Entry> packed;
+
+            for (qsizetype i = next++; i < candidates.size(); i = next++) {
+                const QString& rel = candidates[i];
+                const QString path = this->categoryDir.filePath(rel);
+                const QFileInfo before(path);
+
+                Entry entry;
+                entry.pack = packName;
+                entry.offset = pack.pos();
+                entry.size = before.size();
+                entry.mtime = before.lastModified().toMSecsSinceEpoch();
+
+                QFile in(path);
+                bool ok = in.open(QIODevice::ReadOnly);
+                while (ok && !in.atEnd()) {
+                    const QByteArray raw = in.read(chunkSize);
+                    if (raw.isEmpty()) {
+                        ok = false;
+                        break;
+                    }
+                    QByteArray stored = qCompress(raw, 6);
+                    quint32 header = quint32(stored.size());
+                    if (stored.size() >= raw.size()) {
+                        stored = raw;
+                        header = quint32(raw.size()) | rawChunkFlag;
+                    }
+                    const quint32 le = qToLittleEndian(header);
+                    ok = pack.write(reinterpret_cast<const char*>(&le),
+                                    sizeof(le)) == sizeof(le) &&
+                         pack.write(stored) == stored.size();
+                }
+                in.close();
+
+                // Leave files alone if they changed while being compressed
+                const QFileInfo after(path);
+                if (ok && (after.size() != entry.size ||
+                           after.lastModified() != before.lastModified()))
+                    ok = false;
+
+                if (!ok) {
+                    pack.resize(entry.offset);
+                    pack.seek(entry.offset);
+                    QMutexLocker lock(&mutex);
+                    result.failed++;
+                    continue;
+                }
+
+                entry.storedSize = pack.pos() - entry.offset;
+                packed.insert(rel, entry);
+            }
+
+            const bool synced = syncToDisk(pack);
+            pack.close();
+            QMutexLocker lock(&mutex);
+            if (!synced) {
+                pack.remove();
+                result.failed += int(packed.size());
+                return;
+            }
+            for (auto it = packed.constBegin(); it != packed.constEnd(); ++it) {
+                result.bytesIn += it->size;
+                result.bytesOut += it->storedSize;
+            }
+            added.insert(packed);
+        });
+    }
+    pool.waitForDone();
+
+    // Remove packs that ended up empty
+    for (const QString& packName : packs) {
+        const QString packPath = this->storeDir.filePath(packName);
+        if (QFileInfo(packPath).size() == 0)
+            QFile::remove(packPath);
+    }
+    if (added.isEmpty())
+        return result;
+
+    const QHash<QString, Entry> previous = this->index;
+    this->index.insert(added);
+
+    // Originals are only deleted once the index that points at their
+    // compressed copies is safely on disk
+    if (!this->saveIndex()) {
+        this->index = previous;
+        for (const QString& packName : packs)
+            QFile::remove(this->storeDir.filePath(packName));
+        result.failed += int(added.size());
+        result.bytesIn = result.bytesOut = 0;
+        return result;
+    }
+
+    // A file changed since it was compressed (its new contents are not in
+    // the pack) or that cannot be removed stays where it is, and out of the
+    // index so it is never both on disk and in the store
+    bool dropped = false;
+    for (auto it = added.constBegin(); it != added.constEnd(); ++it) {
+        const QString path = this->categoryDir.filePath(it.key());
+        const QFileInfo now(path);
+        const bool unchanged =
+            now.size() == it->size &&
+            now.lastModified().toMSecsSinceEpoch() == it->mtime;
+        if (unchanged && QFile::remove(path)) {
+            result.archived++;
+            continue;
+        }
+        this->index.remove(it.key());
+        result.failed++;
+        result.bytesIn -= it->size;
+        result.bytesOut -= it->storedSize;
+        dropped = true;
+    }
+    if (dropped && !this->saveIndex())
+        qWarning() << "Could not update the cold storage index in"
+                   << this->storeDir.absolutePath();
+    return result;
+}
+
+bool ColdStorage::restore(const QString& relativePath, QString* error) {
+    auto fail = [error](const QString& message) {
+        if (error)
+            *error = message;
+        return false;
+    };
+
+    const auto it = this->index.constFind(relativePath);
+    if (it == this->index.constEnd())
+        return fail(QStringLiteral("'%1' is not in cold storage.")
+                        .arg(relativePath));
+    const Entry entry = it.value();
+
+    const QString target = this->categoryDir.filePath(relativePath);
+    if (QFileInfo::exists(target))
+        return fail(QStringLiteral("'%1' already exists.").arg(target));
+
+    QFile pack(this->storeDir.filePath(entry.pack));
+    if (!pack.open(QIODevice::ReadOnly) || !pack.seek(entry.offset))
+        return fail(pack.errorString());
+
+    QDir().mkpath(QFileInfo(target).path());
+    QSaveFile out(target);
+    if (!out.open(QIODevice::WriteOnly))
+        return fail(out.errorString());
+
+    const QString truncated =
+        QStringLiteral("Pack '%1' is truncated.").arg(entry.pack);
+    qint64 written = 0;
+    while (written < entry.size) {
+        quint32 le = 0;
+        if (pack.read(reinterpret_cast<char*>(&le), sizeof(le)) != sizeof(le))
+            return fail(truncated);
+        const quint32 header = qFromLittleEndian(le);
+        const qint64 length = header & ~rawChunkFlag;
+        const QByteArray stored = pack.read(length);
+        if (stored.size() != length)
+            return fail(truncated);
+
+        const QByteArray raw =
+            (header & rawChunkFlag) ? stored : qUncompress(stored);
+        if (raw.isEmpty())
+            return fail(
+                QStringLiteral("Pack '%1' is corrupt.").arg(entry.pack));
+        if (out.write(raw) != raw.size())
+            return fail(out.errorString());
+        written += raw.size();
+    }
+    if (!out.commit())
+        return fail(out.errorString());
+
+    QFile restored(target);
+    if (restored.open(QIODevice::ReadWrite)) {
+        restored.setFileTime(QDateTime::fromMSecsSinceEpoch(entry.mtime),
+                             QFileDevice::FileModificationTime);
+        restored.close();
+    }
+
+    this->index.remove(relativePath);
+
+    // Drop the pack once nothing references it any more
+    bool referenced = false;
+    for (const Entry& e : std::as_const(this->index)) {
+        if (e.pack == entry.pack) {
+            referenced = true;
+            break;
+        }
+    }
+    if (!referenced)
+        QFile::remove(this->storeDir.filePath(entry.pack));
+
+    if (!this->saveIndex())
+        return fail(
+            QStringLiteral("Failed to update the cold storage index."));
+    return true;
+}
+
+bool ColdStorage::loadIndex() {
+    this->index.clear();
+    QFile f(this->storeDir.filePath(indexFileName));
+    if (!f.exists())
+        return true;
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    qint64 count = 0;
+    in >> magic >> count;
+    if (magic != indexMagic || count < 0)
+        return false;
+
+    this->index.reserve(count);
+    for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString key;
+        Entry e;
+        in >> key >> e.pack >> e.offset >> e.size >> e.storedSize >> e.mtime;
+        this->index.insert(key, e);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+bool ColdStorage::saveIndex() const {
+    QSaveFile f(this->storeDir.filePath(indexFileName));
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << indexMagic << qint64(this->index.size());
+    for (auto it = this->index.constBegin(); it != this->index.constEnd();
+         ++it) {
+        const Entry& e = it.value();
+        out << it.key() << e.pack << e.offset << e.size << e.storedSize
+            << e.mtime;
+    }
+    return out.status() == QDataStream::Ok && f.commit();
+}
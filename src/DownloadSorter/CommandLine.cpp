@@ -0,0 +1,346 @@
+#include "../Include/DownloadSorter/CommandLine.h"
+#include "../Include/DownloadSorter/ChangeProbe.h"
+#include "../Include/DownloadSorter/DownloadSorter.h"
+#include "../Include/DownloadSorter/EntryProfiler.h"
+#include "../Include/DownloadSorter/FilenameIndex.h"
+#include "../Include/DownloadSorter/SettingsManager.h"
+#include "../Include/DownloadSorter/SortClient.h"
+#include "../Include/DownloadSorter/SortMetrics.h"
+#include "../Include/DownloadSorter/SortService.h"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFileInfo>
+#include <QtCore/QLocale>
+#include <QtCore/QTextStream>
+#include <QtCore/QTimer>
+
+namespace {
+const char* const headlessFlags[] = {"--service", "--sort",  "--dry-run",
+                                     "--status",  "--cancel", "--watch",
+                                     "--reshard", "--profile"};
+
+QTextStream& out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+void printPlan(const QMap<QString, QString>& plan) {
+    for (auto it = plan.begin(); it != plan.end(); ++it)
+        out() << it.key() << " -> " << it.value() << Qt::endl;
+}
+
+void printJobs(const QJsonArray& jobs) {
+    if (jobs.isEmpty())
+        out() << "No sorts running." << Qt::endl;
+    for (const auto& v : jobs) {
+        const QJsonObject job = v.toObject();
+        out() << job.value("kind").toString() << " "
+              << job.value("root").toString() << " ["
+              << job.value("value").toInt() << "/"
+              << job.value("maximum").toInt() << "] "
+              << job.value("message").toString() << " ("
+              << job.value("clients").toInt() << " clients)" << Qt::endl;
+    }
+}
+
+// Keep `path` up to date with the move counters of this process, for a
+// Prometheus node_exporter textfile directory or any other scraper
+void exportMetrics(QCoreApplication& app, const QString& path) {
+    auto write = [path]() {
+        if (!SortMetrics::instance().writeTo(path))
+            qWarning() << "Could not write metrics to" << path;
+    };
+    auto* timer = new QTimer(&app);
+    QObject::connect(timer, &QTimer::timeout, &app, write);
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, &app, write);
+    timer->start(15000);
+    write();
+}
+
+int runService(QCoreApplication& app) {
+    SortService service;
+    if (!service.listen()) {
+        qCritical() << "A sort service is already listening on"
+                    << SortService::serverName();
+        return 1;
+    }
+    return app.exec();
+}
+
+void configure(DownloadSorter& sorter, const SettingsData& settings) {
+    sorter.setFileTypesMap(settings.mappings);
+    sorter.setIgnorePatterns(settings.ignorePatterns);
+    sorter.setColdStorageAgeDays(settings.coldStorageAgeDays);
+    sorter.setRetentionRules(settings.retention);
+    sorter.setViewMode(settings.viewMode, settings.viewFolder);
+    sorter.setDestinationRoots(settings.destinationRoots);
+    sorter.setShardLayouts(settings.shardLayouts);
+    sorter.setLayoutOrderedCopies(settings.layoutOrderedCopies);
+    sorter.setExtractArchives(settings.extractArchives);
+    sorter.setDuplicateFolders(settings.duplicateFolders);
+}
+
+// Report what the rules leave in `roots`, and which mappings would move most
+// of it
+int runProfile(const QStringList& roots) {
+    // Rows printed per histogram
+    constexpr qsizetype shown = 15;
+
+    const SettingsData settings = SettingsManager::read();
+    const RuleSet rules(
+        settings.mappings,
+        DownloadSorter::compileIgnorePatterns(settings.ignorePatterns));
+    QElapsedTimer elapsed;
+    elapsed.start();
+    const EntryProfiler::Report r =
+        EntryProfiler(rules).profile(roots, QThread::idealThreadCount());
+
+    const QLocale locale;
+    out() << r.entries << " entries in " << elapsed.elapsed() << " ms: "
+          << r.unmatched << " unmatched ("
+          << locale.formattedDataSize(r.unmatchedBytes) << "), " << r.ignored
+          << " ignored" << Qt::endl;
+
+    auto print = [&](const char* title,
+                     const QVector<EntryProfiler::Row>& rows,
+                     const QString& prefix) {
+        if (rows.isEmpty())
+            return;
+        out() << Qt::endl << title << Qt::endl;
+        for (qsizetype i = 0; i < qMin(shown, rows.size()); ++i) {
+            const EntryProfiler::Row& row = rows[i];
+            const QString key = row.key.isEmpty() ? QStringLiteral("(none)")
+                                                  : prefix + row.key;
+            out() << QStringLiteral("  %1 %2 files %3")
+                         .arg(key, -24)
+                         .arg(row.count, 9)
+                         .arg(locale.formattedDataSize(row.bytes), 10)
+                  << Qt::endl;
+        }
+        if (rows.size() > shown)
+            out() << "  ... " << rows.size() - shown << " more" << Qt::endl;
+    };
+    print("By suffix:", r.suffixes, QStringLiteral("."));
+    print("By leading name word:", r.prefixes, QString());
+    print("By content:", r.families, QString());
+
+    if (!r.suggestions.isEmpty())
+        out() << Qt::endl << "Suggested mappings:" << Qt::endl;
+    for (const EntryProfiler::Suggestion& s : r.suggestions) {
+        out() << QStringLiteral("  .%1 -> %2 (%3 files, %4)")
+                     .arg(s.suffix, s.folder)
+                     .arg(s.count)
+                     .arg(locale.formattedDataSize(s.bytes))
+              << Qt::endl;
+    }
+    return 0;
+}
+
+// Used when no service is reachable: sort inside this process instead
+int runLocally(const QString& root, bool dryRun) {
+    DownloadSorter sorter(root);
+    configure(sorter, SettingsManager::read());
+    sorter.setDryRun(dryRun);
+
+    // Nothing else needs an event loop, so sort on this thread
+    SortCallbacks callbacks;
+    callbacks.status = [](const QString& m) { out() << m << Qt::endl; };
+    callbacks.planReady = &printPlan;
+    sorter.setCallbacks(callbacks);
+    sorter.run();
+    // Scripts can tell a sort that left downloads behind from a clean one
+    return sorter.completed() ? 0 : 1;
+}
+
+// Sort `root` whenever it changes. Polls instead of relying on change
+// notifications, which never arrive for NFS and SMB mounts; a quiet poll is
+// a single statx() and never lists or plans anything.
+int runWatch(QCoreApplication& app, const QString& root, bool digestNames) {
+    ChangeProbe probe(root, digestNames);
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, &QTimer::timeout, &app, [&]() {
+        if (!probe.changed()) {
+            timer.start(probe.intervalMs());
+            return;
+        }
+
+        // Settings are re-read so edits apply without restarting the watch
+        auto* sorter = new DownloadSorter(root);
+        configure(*sorter, SettingsManager::read());
+        QObject::connect(sorter, &DownloadSorter::statusMessage, &app,
+                         [](const QString& m) { out() << m << Qt::endl; });
+        QObject::connect(sorter, &QThread::finished, &app, [&, sorter]() {
+            sorter->deleteLater();
+            // Poll again right away: the sort's own moves show as a change,
+            // and so does anything that arrived while it ran. The extra
+            // sort plans nothing when nothing new is there.
+            timer.start(0);
+        });
+        sorter->start();
+    });
+    out() << "Watching " << root << Qt::endl;
+    timer.start(0);
+    return app.exec();
+}
+
+// Move what the category folders of `root` already hold from the `from`
+// layout into the one each category is configured with
+int runReshard(const QString& root, const QString& fromText) {
+    bool ok = false;
+    const ShardLayout from = ShardLayout::parse(fromText, &ok);
+    if (!ok) {
+        qCritical().noquote() << "Unknown layout" << fromText;
+        return 1;
+    }
+
+    const SettingsData settings = SettingsManager::read();
+    const Resharder resharder;
+    int failed = 0;
+    for (const QString& category :
+         DownloadSorter::managedFolders(settings.mappings)) {
+        const ShardLayout to = settings.shardLayouts.value(category);
+        const QString folder = DownloadSorter::categoryPath(
+            root, category, settings.destinationRoots);
+        if (to == from || !QFileInfo(folder).isDir())
+            continue;
+
+        out() << category << ": " << (from.isFlat() ? "flat" : from.toString())
+              << " -> " << (to.isFlat() ? "flat" : to.toString()) << "..."
+              << Qt::endl;
+        const Resharder::Result r =
+            resharder.reshard(folder, from, to, QThread::idealThreadCount());
+        out() << "  " << r.moved << " moved, " << r.unchanged
+              << " already in place, " << r.failed << " failed" << Qt::endl;
+        failed += r.failed;
+        if (r.moved > 0)
+            FilenameIndex::invalidateSnapshot(root);
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+int runClient(QCoreApplication& app, const QCommandLineParser& parser) {
+    const bool dryRun = parser.isSet("dry-run");
+    const QString root =
+        parser.value(dryRun ? "dry-run" : parser.isSet("sort") ? "sort"
+                                                                : "cancel");
+
+    SortClient client;
+    client.connectToService();
+    if (!client.waitForConnected(500)) {
+        if (parser.isSet("status") || parser.isSet("cancel")) {
+            out() << "No sort service is running." << Qt::endl;
+            return 1;
+        }
+        return runLocally(root, dryRun);
+    }
+
+    QObject::connect(&client, &SortClient::statusMessage, &app,
+                     [&](const QString& m) {
+                         out() << m << Qt::endl;
+                         if (parser.isSet("cancel"))
+                             app.exit(0);
+                     });
+    QObject::connect(&client, &SortClient::planReady, &app, &printPlan);
+    QObject::connect(&client, &SortClient::statusReport, &app,
+                     [&](const QJsonArray& jobs) {
+                         printJobs(jobs);
+                         app.exit(0);
+                     });
+    QObject::connect(&client, &SortClient::errorMessage, &app,
+                     [&](const QString& m) {
+                         qCritical().noquote() << m;
+                         app.exit(1);
+                     });
+    QObject::connect(&client, &SortClient::finished, &app,
+                     [&](bool completed) { app.exit(completed ? 0 : 1); });
+    QObject::connect(&client, &SortClient::disconnected, &app, [&]() {
+        qCritical() << "Lost connection to the sort service.";
+        app.exit(1);
+    });
+
+    if (parser.isSet("status"))
+        client.requestStatus();
+    else if (parser.isSet("cancel"))
+        client.cancel(root);
+    else if (dryRun)
+        client.dryRun(root);
+    else
+        client.sort(root);
+    return app.exec();
+}
+}  // namespace
+
+bool CommandLine::isHeadless(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray arg(argv[i]);
+        for (const char* flag : headlessFlags) {
+            if (arg == flag || arg.startsWith(QByteArray(flag) + "="))
+                return true;
+        }
+    }
+    return false;
+}
+
+int CommandLine::run(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+#ifdef APP_VERSION
+    QCoreApplication::setApplicationVersion(QString::fromUtf8(APP_VERSION));
+#endif
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Download Sorter");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"service", "Run the resident sort service."},
+        {"sort", "Sort <folder> (through the service when one is running).",
+         "folder"},
+        {"dry-run", "Print what sorting <folder> would move.", "folder"},
+        {"status", "List the sorts the service is running."},
+        {"cancel", "Cancel the running sort of <folder>.", "folder"},
+        {"watch",
+         "Sort <folder> in this process whenever it changes, polling "
+         "(for network mounts without change notifications).",
+         "folder"},
+        {"watch-names",
+         "With --watch, also compare entry names on every poll (catches "
+         "changes coarse server timestamps miss)."},
+        {"reshard",
+         "Move what the category folders of <folder> hold into their "
+         "configured sharding layouts.",
+         "folder"},
+        {"from",
+         "With --reshard, the layout the folders use now (default: flat).",
+         "layout"},
+        {"profile",
+         "Report which files the rules leave in <folder> (repeat for more "
+         "folders) and suggest mappings for them.",
+         "folder"},
+        {"metrics-file",
+         "With --service or --watch, keep <file> updated with move metrics "
+         "in the Prometheus text format.",
+         "file"},
+    });
+    parser.process(app);
+    // Only reachable without a mode from the widget-free binary
+    if (!CommandLine::isHeadless(argc, argv))
+        parser.showHelp(1);
+
+    const bool resident = parser.isSet("service") || parser.isSet("watch");
+    if (resident && parser.isSet("metrics-file"))
+        exportMetrics(app, parser.value("metrics-file"));
+
+    if (parser.isSet("service"))
+        return runService(app);
+    if (parser.isSet("profile"))
+        return runProfile(parser.values("profile"));
+    if (parser.isSet("reshard"))
+        return runReshard(parser.value("reshard"), parser.value("from"));
+    if (parser.isSet("watch"))
+        return runWatch(app, parser.value("watch"),
+                        parser.isSet("watch-names"));
+    return runClient(app, parser);
+}
@@ -1,55 +1,74 @@
 #include "../Include/DownloadSorter/Dashboard.h"
+#include "../Include/DownloadSorter/ColdStorage.h"
 #include "../Include/DownloadSorter/DownloadSorter.h"
+#include "../Include/DownloadSorter/FilenameIndex.h"
+#include "../Include/DownloadSorter/RetentionSweeper.h"
 #include "../Include/DownloadSorter/SettingsDialog.h"
 #include "../Include/DownloadSorter/SettingsManager.h"
+#include "../Include/DownloadSorter/SortClient.h"
+#include "../Include/DownloadSorter/StartupTrace.h"
+#include "../Include/DownloadSorter/StorageStats.h"
 
 #include <QAction>
+#include <QDesktopServices>
 #include <QFile>
+#include <QInputDialog>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QListWidget>
+#include <QLocale>
 #include <QMenu>
 #include <QMenuBar>
 #include <QStandardPaths>
+#include <QTimer>
+#include <QUrl>
 
 #include <QApplication>
 #include <QPalette>
 
+namespace {
+// How long a freshly launched service gets to start listening
+constexpr int serviceStartPollMs = 100;
+constexpr int serviceStartAttempts = 30;
+}  // namespace
+
 void setDarkTheme() {
     QApplication::setStyle("Fusion");
 
-    QPalette* dark_palette = new QPalette();
+    QPalette dark_palette;
     QColor baseColor(31, 31, 31);
     QColor textColor(Qt::white);
     // Use a green accent
     QColor highlightColor(0, 136, 57);  // rgb(0, 146, 61)
     QColor disabledTextColor(Qt::darkGray);
 
-    dark_palette->setColor(QPalette::Window, baseColor);
-    dark_palette->setColor(QPalette::WindowText, textColor);
-    dark_palette->setColor(QPalette::Base,
-                           baseColor.darker(160));  // slightly darker
-    dark_palette->setColor(QPalette::AlternateBase, baseColor);
-    dark_palette->setColor(QPalette::ToolTipBase, baseColor.darker(120));
-    dark_palette->setColor(QPalette::ToolTipText, textColor);
-    dark_palette->setColor(QPalette::Text, textColor);
-    dark_palette->setColor(QPalette::Button, baseColor);
-    dark_palette->setColor(QPalette::ButtonText, textColor);
-    dark_palette->setColor(QPalette::BrightText, Qt::red);
-    dark_palette->setColor(QPalette::Link, highlightColor);
-    dark_palette->setColor(QPalette::Highlight, highlightColor);
+    dark_palette.setColor(QPalette::Window, baseColor);
+    dark_palette.setColor(QPalette::WindowText, textColor);
+    dark_palette.setColor(QPalette::Base,
+                          baseColor.darker(160));  // slightly darker
+    dark_palette.setColor(QPalette::AlternateBase, baseColor);
+    dark_palette.setColor(QPalette::ToolTipBase, baseColor.darker(120));
+    dark_palette.setColor(QPalette::ToolTipText, textColor);
+    dark_palette.setColor(QPalette::Text, textColor);
+    dark_palette.setColor(QPalette::Button, baseColor);
+    dark_palette.setColor(QPalette::ButtonText, textColor);
+    dark_palette.setColor(QPalette::BrightText, Qt::red);
+    dark_palette.setColor(QPalette::Link, highlightColor);
+    dark_palette.setColor(QPalette::Highlight, highlightColor);
     // Ensure selected/hovered text stays readable (white on green)
-    dark_palette->setColor(QPalette::HighlightedText, Qt::white);
-    dark_palette->setColor(QPalette::Active, QPalette::Button, baseColor);
-    dark_palette->setColor(QPalette::Disabled, QPalette::ButtonText,
-                           disabledTextColor);
-    dark_palette->setColor(QPalette::Disabled, QPalette::WindowText,
-                           disabledTextColor);
-    dark_palette->setColor(QPalette::Disabled, QPalette::Text,
-                           disabledTextColor);
-    dark_palette->setColor(QPalette::Disabled, QPalette::Light, baseColor);
-    QApplication::setPalette(*dark_palette);
-
+    dark_palette.setColor(QPalette::HighlightedText, Qt::white);
+    dark_palette.setColor(QPalette::Active, QPalette::Button, baseColor);
+    dark_palette.setColor(QPalette::Disabled, QPalette::ButtonText,
+                          disabledTextColor);
+    dark_palette.setColor(QPalette::Disabled, QPalette::WindowText,
+                          disabledTextColor);
+    dark_palette.setColor(QPalette::Disabled, QPalette::Text,
+                          disabledTextColor);
+    dark_palette.setColor(QPalette::Disabled, QPalette::Light, baseColor);
+    QApplication::setPalette(dark_palette);
+
+    // Only what the first frame shows; menu rules are applied to the menu bar
     qApp->setStyleSheet(R"(
             QGroupBox { 
     border: 1px solid #2f2f2f;
@@ -70,6 +89,20 @@ QFrame[frameShape="4"] { /* QFrame::HLine */
     margin: 0.5em 0;
 }
 
+/* Inputs */
+QLineEdit {
+    background: #2a2a2a;
+    color: #ffffff;
+    selection-background-color:rgb(0, 136, 57);
+    selection-color: #ffffff;
+    border: 1px solid #3a3a3a;
+    border-radius: 3px;
+}
+)");
+}
+
+// Menu bar rules, needed for the first frame
+const char* const menuBarStyleSheet = R"(
 /* Menu bar */
 QMenuBar {
     background-color: #262626;
@@ -87,7 +120,10 @@ QMenuBar::item:pressed {
 QMenuBar::item:disabled {
     color: #666666;
 }
+)";
 
+// Drop-down menu rules, added once the menus are filled in
+const char* const menuStyleSheet = R"(
 /* Menus and submenus */
 QMenu {
     background-color: #262626;
@@ -110,26 +146,28 @@ QMenu::item:selected {
 QMenu::item:disabled {
     color: #666666;
 }
-
-/* Inputs */
-QLineEdit {
-    background: #2a2a2a;
-    color: #ffffff;
-    selection-background-color:rgb(0, 136, 57);
-    selection-color: #ffffff;
-    border: 1px solid #3a3a3a;
-    border-radius: 3px;
+)";
+
+// The download path is the only thing kept in QSettings; open it briefly
+// instead of keeping one alive for the window's lifetime
+QString storedDownloadPath() {
+    const QSettings settings(QSettings::NativeFormat, QSettings::UserScope,
+                             "Yangkie", "Download Sorter");
+    return settings.value("Download Path").toString();
 }
-)");
+
+void storeDownloadPath(const QString& path) {
+    QSettings settings(QSettings::NativeFormat, QSettings::UserScope,
+                       "Yangkie", "Download Sorter");
+    settings.setValue("Download Path", path);
 }
 
 Dashboard::Dashboard() {
     // ++ Retrieving settings
     setDarkTheme();
+    StartupTrace::mark("theme");
 
-    this->setWindowIcon(QIcon(":/appicon"));
-
-    QString retrieved_path = this->settings->value("Download Path").toString();
+    QString retrieved_path = storedDownloadPath();
     if (retrieved_path.isEmpty()) {
         this->currentDownloadFolder =
             QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
@@ -137,23 +175,12 @@ Dashboard::Dashboard() {
         this->currentDownloadFolder = retrieved_path;
     }
 
-    // Menu with "Configure Rules..." action
+    // Only the menu titles exist for the first frame; their actions are
+    // added by finishStartup()
+    this->menuBar()->setStyleSheet(menuBarStyleSheet);
     this->rulesMenu = this->menuBar()->addMenu("&Rules");
-    this->configureRulesAction =
-        this->rulesMenu->addAction("Configure Rules...");
-    QObject::connect(this->configureRulesAction, &QAction::triggered, this,
-                     [this]() { this->openRulesConfigurator(); });
-
-    // Help menu and actions
+    this->toolsMenu = this->menuBar()->addMenu("&Tools");
     this->helpMenu = this->menuBar()->addMenu("&Help");
-    this->checkUpdatesAction =
-        this->helpMenu->addAction("Check for &Updates...");
-    QObject::connect(this->checkUpdatesAction, &QAction::triggered, this,
-                     &Dashboard::checkForUpdates);
-    this->helpMenu->addSeparator();
-    this->aboutAction = this->helpMenu->addAction("&About Download Sorter");
-    QObject::connect(this->aboutAction, &QAction::triggered, this,
-                     &Dashboard::showAbout);
 
     // Status-bar progress bar (hidden by default)
     this->progressBar = new QProgressBar(this);
@@ -179,8 +206,8 @@ Dashboard::Dashboard() {
 
     // QLineEdit* pathField = new QLineEdit();
 
-    QIcon* search_icon = new QIcon(":/search.png");
-    QPushButton* search_btn = new QPushButton(*search_icon, "");
+    const QIcon search_icon(":/search.png");
+    QPushButton* search_btn = new QPushButton(search_icon, "");
     QObject::connect(search_btn, &QPushButton::clicked, this,
                      &Dashboard::browseDownloadFolder);
 
@@ -190,7 +217,7 @@ Dashboard::Dashboard() {
 
     arrangeButton->setFixedHeight(40);
 
-    this->pathField->setText(this->currentDownloadFolder);
+    this->pathField = new QLineEdit(this->currentDownloadFolder);
 
     searcherlayout->addWidget(this->pathField);
     searcherlayout->addWidget(search_btn);
@@ -200,6 +227,36 @@ Dashboard::Dashboard() {
 
     mainlayout->addLayout(browserlayout);
 
+    /* Search */
+    this->searchField = new QLineEdit();
+    this->searchField->setPlaceholderText("Search sorted downloads...");
+    this->searchField->addAction(search_icon, QLineEdit::LeadingPosition);
+    this->searchField->setClearButtonEnabled(true);
+    QObject::connect(this->searchField, &QLineEdit::textChanged, this,
+                     &Dashboard::runSearch);
+
+    this->searchResults = new QListWidget();
+    this->searchResults->hide();
+    QObject::connect(this->searchResults, &QListWidget::itemActivated, this,
+                     [](QListWidgetItem* item) {
+                         QDesktopServices::openUrl(QUrl::fromLocalFile(
+                             item->data(Qt::UserRole).toString()));
+                     });
+
+    mainlayout->addSpacing(10);
+    mainlayout->addWidget(this->searchField);
+    mainlayout->addWidget(this->searchResults);
+
+    /* Storage statistics */
+    QGroupBox* statsGroup = new QGroupBox("Storage");
+    QVBoxLayout* statsLayout = new ModQVBoxLayout();
+    this->statsLabel = new QLabel();
+    this->statsLabel->setTextFormat(Qt::RichText);
+    statsLayout->addWidget(this->statsLabel);
+    statsGroup->setLayout(statsLayout);
+    mainlayout->addSpacing(10);
+    mainlayout->addWidget(statsGroup);
+
     mainlayout->addSpacing(10);
     mainlayout->addStretch(2);
     mainlayout->addWidget(arrangeButton);
@@ -212,6 +269,73 @@ Dashboard::Dashboard() {
     this->statusBar()->show();
 
     this->setMinimumWidth(450);
+
+    // Sorts go through the resident service when it is running, so several
+    // windows and scripts share one warm sorter
+    this->sortClient = new SortClient(this);
+    QObject::connect(this->sortClient, &SortClient::progressRangeChanged, this,
+                     [this](int min, int max) {
+                         this->progressBar->setRange(min, max);
+                         this->progressBar->show();
+                     });
+    QObject::connect(this->sortClient, &SortClient::progressValueChanged, this,
+                     [this](int value) { this->progressBar->setValue(value); });
+    QObject::connect(
+        this->sortClient, &SortClient::statusMessage, this,
+        [this](const QString& m) { this->statusBar()->showMessage(m); });
+    QObject::connect(
+        this->sortClient, &SortClient::errorMessage, this,
+        [this](const QString& m) { this->statusBar()->showMessage(m, 5000); });
+    QObject::connect(this->sortClient, &SortClient::contentsMoved, this,
+                     &Dashboard::indexMovedContents);
+    QObject::connect(this->sortClient, &SortClient::categoriesChanged, this,
+                     [this]() { this->buildSearchIndex(true); });
+    QObject::connect(this->sortClient, &SortClient::finished, this,
+                     [this]() {
+                         this->serviceSortRunning = false;
+                         this->downloadFinished();
+                     });
+    QObject::connect(this->sortClient, &SortClient::disconnected, this,
+                     &Dashboard::serviceLost);
+
+    StartupTrace::mark("widgets");
+    StartupTrace::onFirstFrame(this, [this]() { this->finishStartup(); });
+}
+
+// Everything the first frame does not need: menu actions and their styling,
+// the statistics file, the service connection and the search index
+void Dashboard::finishStartup() {
+    this->configureRulesAction =
+        this->rulesMenu->addAction("Configure Rules...");
+    QObject::connect(this->configureRulesAction, &QAction::triggered, this,
+                     [this]() { this->openRulesConfigurator(); });
+
+    this->restoreColdAction =
+        this->toolsMenu->addAction("Restore from Cold Storage...");
+    QObject::connect(this->restoreColdAction, &QAction::triggered, this,
+                     &Dashboard::restoreFromColdStorage);
+    this->retentionSweepAction =
+        this->toolsMenu->addAction("Apply Retention Rules...");
+    QObject::connect(this->retentionSweepAction, &QAction::triggered, this,
+                     &Dashboard::sweepRetention);
+
+    this->checkUpdatesAction =
+        this->helpMenu->addAction("Check for &Updates...");
+    QObject::connect(this->checkUpdatesAction, &QAction::triggered, this,
+                     &Dashboard::checkForUpdates);
+    this->helpMenu->addSeparator();
+    this->aboutAction = this->helpMenu->addAction("&About Download Sorter");
+    QObject::connect(this->aboutAction, &QAction::triggered, this,
+                     &Dashboard::showAbout);
+
+    this->menuBar()->setStyleSheet(QString::fromLatin1(menuBarStyleSheet) +
+                                   QString::fromLatin1(menuStyleSheet));
+    StartupTrace::mark("menus");
+
+    this->refreshStorageStats();
+    this->sortClient->connectToService();
+    this->buildSearchIndex();
+    StartupTrace::mark("deferred startup");
 }
 
 void Dashboard::initiateSort() {
@@ -221,12 +345,80 @@ void Dashboard::initiateSort() {
         this->progressBar->setValue(0);
     }
 
+    if (this->sortClient->isConnected()) {
+        this->sortThroughService();
+        return;
+    }
+    if (this->awaitingService)
+        return;
+    if (!SortClient::launchService()) {
+        this->sortInProcess();
+        return;
+    }
+
+    // Hand this sort to the new service once it is listening, so a sort of
+    // the same folder from the command line or another window joins it
+    // instead of running beside it. Only if it never comes up is the folder
+    // sorted here.
+    this->awaitingService = true;
+    this->onSortStarted();
+    this->statusBar()->showMessage("Starting the sort service...");
+    auto* poll = new QTimer(this);
+    auto attempts = std::make_shared<int>(0);
+    QObject::connect(poll, &QTimer::timeout, this, [this, poll, attempts]() {
+        const bool connected = this->sortClient->isConnected();
+        if (!connected && ++*attempts < serviceStartAttempts) {
+            this->sortClient->connectToService();
+            return;
+        }
+        poll->deleteLater();
+        this->awaitingService = false;
+        if (connected)
+            this->sortThroughService();
+        else
+            this->sortInProcess();
+    });
+    this->sortClient->connectToService();
+    poll->start(serviceStartPollMs);
+}
+
+void Dashboard::sortThroughService() {
+    this->onSortStarted();
+    this->serviceSortRunning = true;
+    this->sortClient->sort(this->currentDownloadFolder);
+}
+
+// The service went away (crashed, or was stopped) with a sort in flight
+void Dashboard::serviceLost() {
+    if (!this->serviceSortRunning)
+        return;
+    this->serviceSortRunning = false;
+    if (this->progressBar) {
+        this->progressBar->hide();
+        this->progressBar->setRange(0, 100);
+        this->progressBar->setValue(0);
+    }
+    this->statusBar()->showMessage(
+        QString("Lost the sort service; sorting '%1' may not have finished.")
+            .arg(this->currentDownloadFolder));
+    this->refreshStorageStats();
+}
+
+void Dashboard::sortInProcess() {
     auto* ds = new DownloadSorter(this->currentDownloadFolder);
 
     // Get settings from SettingsManager
     const SettingsData settings = SettingsManager::read();
     ds->setFileTypesMap(settings.mappings);
     ds->setIgnorePatterns(settings.ignorePatterns);
+    ds->setColdStorageAgeDays(settings.coldStorageAgeDays);
+    ds->setRetentionRules(settings.retention);
+    ds->setViewMode(settings.viewMode, settings.viewFolder);
+    ds->setDestinationRoots(settings.destinationRoots);
+    ds->setShardLayouts(settings.shardLayouts);
+    ds->setLayoutOrderedCopies(settings.layoutOrderedCopies);
+    ds->setExtractArchives(settings.extractArchives);
+    ds->setDuplicateFolders(settings.duplicateFolders);
 
     // Wire progress to status bar progress bar (use qualified
     // pointer-to-member)
@@ -246,6 +438,10 @@ void Dashboard::initiateSort() {
     QObject::connect(
         ds, &DownloadSorter::statusMessage, this,
         [this](const QString& m) { this->statusBar()->showMessage(m); });
+    QObject::connect(ds, &DownloadSorter::contentsMoved, this,
+                     &Dashboard::indexMovedContents);
+    QObject::connect(ds, &DownloadSorter::categoriesChanged, this,
+                     [this]() { this->buildSearchIndex(true); });
     QObject::connect(ds, &DownloadSorter::finished, this,
                      &Dashboard::downloadFinished);
     QObject::connect(ds, &QThread::finished, ds, &QObject::deleteLater);
@@ -257,6 +453,7 @@ void Dashboard::initiateSort() {
 void Dashboard::downloadFinished() {
     this->statusBar()->showMessage(
         QString("Finished: '%1'").arg(this->currentDownloadFolder), 5000);
+    this->refreshStorageStats();
 }
 
 void Dashboard::browseDownloadFolder() {
@@ -272,7 +469,9 @@ void Dashboard::browseDownloadFolder() {
 
     this->pathField->setText(this->currentDownloadFolder);
 
-    this->settings->setValue("Download Path", this->currentDownloadFolder);
+    storeDownloadPath(this->currentDownloadFolder);
+    this->refreshStorageStats();
+    this->buildSearchIndex();
 
     QString message = QString("Set '%1' as the current download folder")
                           .arg(this->currentDownloadFolder);
@@ -292,9 +491,287 @@ void Dashboard::onSortStarted() {
 // Open settings dialog for rules from the menu action
 void Dashboard::openRulesConfigurator() {
     // One-call helper: loads, shows, and persists on accept
-    if (SettingsDialog::editSettings(this)) {
+    if (SettingsDialog::editSettings(this, this->currentDownloadFolder)) {
         this->statusBar()->showMessage("Settings saved.", 3000);
     } else {
         this->statusBar()->showMessage("Settings unchanged.", 3000);
     }
 }
+
+// Let the user pick a compressed file and put it back where it was
+void Dashboard::restoreFromColdStorage() {
+    const SettingsData data = SettingsManager::read();
+    QMap<QString, QString> categories;  // name -> folder, wherever it lives
+    QStringList choices;
+    for (const QString& path : DownloadSorter::categoryPaths(
+             this->currentDownloadFolder, data.mappings,
+             data.destinationRoots)) {
+        const QDir categoryDir(path);
+        if (!categoryDir.exists(ColdStorage::storeDirName))
+            continue;
+        categories.insert(categoryDir.dirName(), path);
+        const ColdStorage store(path);
+        for (const QString& rel : store.entries())
+            choices.append(categoryDir.dirName() + "/" + rel);
+    }
+
+    if (choices.isEmpty()) {
+        this->statusBar()->showMessage("Cold storage is empty.", 3000);
+        return;
+    }
+    choices.sort(Qt::CaseInsensitive);
+
+    bool ok = false;
+    const QString choice =
+        QInputDialog::getItem(this, "Restore from Cold Storage",
+                              "File to restore:", choices, 0, false, &ok);
+    if (!ok || choice.isEmpty())
+        return;
+
+    const qsizetype slash = choice.indexOf('/');
+    const QDir categoryDir(categories.value(choice.left(slash)));
+    ColdStorage store(categoryDir.absolutePath());
+    QString error;
+    if (store.restore(choice.mid(slash + 1), &error)) {
+        this->statusBar()->showMessage(
+            QString("Restored '%1'")
+                .arg(categoryDir.filePath(choice.mid(slash + 1))),
+            5000);
+    } else {
+        QMessageBox::warning(this, "Restore Failed", error);
+    }
+}
+
+// Preview what the retention rules would delete, then delete it on request.
+// Both passes run on the background pool so large folders never block the UI.
+void Dashboard::sweepRetention() {
+    const SettingsData data = SettingsManager::read();
+    if (data.retention.isEmpty()) {
+        this->statusBar()->showMessage(
+            "No retention rules. Add them under Rules > Configure Rules...",
+            5000);
+        return;
+    }
+
+    const QString root = this->currentDownloadFolder;
+    const QMap<QString, RetentionRule> rules = data.retention;
+    const QMap<QString, QString> roots = data.destinationRoots;
+    const QMap<QString, ShardLayout> layouts = data.shardLayouts;
+    this->retentionSweepAction->setEnabled(false);
+    this->statusBar()->showMessage("Checking retention rules...");
+
+    this->backgroundPool.start([this, root, rules, roots, layouts]() {
+        const RetentionSweeper::Result preview =
+            RetentionSweeper(root, rules, roots, layouts)
+                .plan(QThread::idealThreadCount());
+        QMetaObject::invokeMethod(
+            this,
+            [this, root, rules, roots, layouts, preview]() {
+                this->retentionSweepAction->setEnabled(true);
+                if (preview.victims.isEmpty()) {
+                    this->statusBar()->showMessage(
+                        "Retention rules allow everything that is kept.",
+                        5000);
+                    return;
+                }
+
+                const QDir rootDir(root);
+                qint64 bytes = 0;
+                QStringList lines;
+                for (const RetentionSweeper::Item& item : preview.victims) {
+                    bytes += item.size;
+                    // Categories with their own root show in full
+                    const QString rel = rootDir.relativeFilePath(item.path);
+                    lines.append(rel.startsWith("..") ? item.path : rel);
+                }
+
+                QMessageBox box(QMessageBox::Question, "Apply Retention Rules",
+                                QString("Delete %1 items (%2)?")
+                                    .arg(preview.victims.size())
+                                    .arg(QLocale().formattedDataSize(bytes)),
+                                QMessageBox::Yes | QMessageBox::No, this);
+                box.setDetailedText(lines.join("\n"));
+                if (box.exec() != QMessageBox::Yes)
+                    return;
+
+                this->retentionSweepAction->setEnabled(false);
+                this->statusBar()->showMessage("Applying retention rules...");
+                // Exactly what was confirmed, not a fresh plan
+                this->backgroundPool.start([this, root, rules, roots, layouts,
+                                            victims = preview.victims]() {
+                    const RetentionSweeper::Result r = RetentionSweeper::remove(
+                        victims, QThread::idealThreadCount());
+
+                    // Bring the statistics back in line with what is left
+                    QStringList folders;
+                    for (auto it = rules.begin(); it != rules.end(); ++it)
+                        folders.append(DownloadSorter::categoryPath(
+                            root, it.key(), roots));
+                    StorageStats stats(root);
+                    stats.reconcile(folders, layouts);
+                    stats.save();
+
+                    QMetaObject::invokeMethod(
+                        this,
+                        [this, r]() {
+                            this->retentionSweepAction->setEnabled(true);
+                            this->statusBar()->showMessage(
+                                QString("Removed %1 items (%2), %3 failed.")
+                                    .arg(r.removed)
+                                    .arg(QLocale().formattedDataSize(
+                                        r.bytesFreed))
+                                    .arg(r.failed),
+                                5000);
+                            this->refreshStorageStats();
+                            this->buildSearchIndex(true);
+                        },
+                        Qt::QueuedConnection);
+                });
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+// Show the persisted per-category numbers; no folder walking happens here
+void Dashboard::refreshStorageStats() {
+    const StorageStats stats(this->currentDownloadFolder);
+    const auto& categories = stats.categories();
+    if (categories.isEmpty()) {
+        this->statsLabel->setText(
+            "No statistics yet. They are collected on the next sort.");
+        this->statsLabel->setToolTip(QString());
+        return;
+    }
+
+    const QLocale locale;
+    QString rows;
+    QStringList details;
+    for (auto it = categories.begin(); it != categories.end(); ++it) {
+        const StorageStats::Category& c = it.value();
+        rows += QString("<tr><td>%1</td><td align=\"right\">%2 items</td>"
+                        "<td align=\"right\">%3</td></tr>")
+                    .arg(it.key().toHtmlEscaped(), locale.toString(c.count),
+                         locale.formattedDataSize(c.bytes));
+
+        QStringList sizes;
+        for (int b = 0; b < StorageStats::sizeBucketCount; ++b)
+            sizes.append(QString("%1: %2").arg(StorageStats::sizeBucketLabel(b))
+                             .arg(c.sizes[b]));
+        QStringList ages;
+        const auto ageHistogram = StorageStats::ageHistogram(c);
+        for (int b = 0; b < StorageStats::ageBucketCount; ++b)
+            ages.append(QString("%1: %2").arg(StorageStats::ageBucketLabel(b))
+                            .arg(ageHistogram[b]));
+        details.append(QString("%1\n  Size: %2\n  Age: %3")
+                           .arg(it.key(), sizes.join(", "), ages.join(", ")));
+    }
+
+    this->statsLabel->setText("<table width=\"100%\">" + rows + "</table>");
+    this->statsLabel->setToolTip(details.join("\n"));
+}
+
+// Load (or walk and snapshot) the names in the category folders off the GUI
+// thread, then swap the finished index in
+void Dashboard::buildSearchIndex(bool rescan) {
+    const QString root = this->currentDownloadFolder;
+    const SettingsData data = SettingsManager::read();
+    const QStringList folders = DownloadSorter::categoryPaths(
+        root, data.mappings, data.destinationRoots);
+
+    this->searchIndex.reset();
+    const int generation = ++this->indexGeneration;
+    this->backgroundPool.start([this, root, folders, rescan, generation]() {
+        QStringList paths;
+        if (!rescan && FilenameIndex::snapshotIsFresh(root, folders))
+            paths = FilenameIndex::loadSnapshot(root);
+        if (paths.isEmpty()) {
+            paths = FilenameIndex::scan(folders);
+            QMutexLocker lock(&this->snapshotMutex);
+            if (generation == this->indexGeneration)
+                FilenameIndex::saveSnapshot(root, paths);
+        }
+
+        auto index = std::make_shared<FilenameIndex>();
+        index->build(paths);
+        QMetaObject::invokeMethod(
+            this,
+            [this, root, index]() {
+                // The folder may have changed while this was building
+                if (root != this->currentDownloadFolder)
+                    return;
+                this->searchIndex = index;
+                this->runSearch(this->searchField->text());
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void Dashboard::runSearch(const QString& query) {
+    this->searchResults->clear();
+    if (query.trimmed().isEmpty()) {
+        this->searchResults->hide();
+        return;
+    }
+    this->searchResults->show();
+
+    if (!this->searchIndex) {
+        this->searchResults->addItem("Indexing sorted downloads...");
+        return;
+    }
+    // An update on the background pool runs the search again when done
+    if (!this->searchMutex.tryLock()) {
+        this->searchResults->addItem("Updating the index...");
+        return;
+    }
+    const QStringList found = this->searchIndex->search(query);
+    this->searchMutex.unlock();
+
+    const QDir root(this->currentDownloadFolder);
+    for (const QString& path : found) {
+        auto* item = new QListWidgetItem(root.relativeFilePath(path),
+                                         this->searchResults);
+        item->setData(Qt::UserRole, path);
+        item->setToolTip(path);
+    }
+    if (this->searchResults->count() == 0)
+        this->searchResults->addItem("No matches.");
+}
+
+// Keep the index in step with a sort instead of re-walking the folders. The
+// moved folders are walked, the index updated and the snapshot written on
+// the background pool; the GUI thread only runs the search again.
+void Dashboard::indexMovedContents(const QMap<QString, QString>& moved) {
+    if (!this->searchIndex || moved.isEmpty())
+        return;
+
+    const QString root = this->currentDownloadFolder;
+    const std::shared_ptr<FilenameIndex> index = this->searchIndex;
+    const int generation = this->indexGeneration;
+    this->backgroundPool.start([this, root, index, generation, moved]() {
+        // Walked before taking the lock, so searches only wait for the
+        // index update itself
+        QStringList added;
+        for (auto it = moved.begin(); it != moved.end(); ++it) {
+            added.append(it.value());
+            if (QFileInfo(it.value()).isDir())
+                added.append(FilenameIndex::scan({it.value()}));
+        }
+
+        QStringList paths;
+        {
+            QMutexLocker lock(&this->searchMutex);
+            for (auto it = moved.begin(); it != moved.end(); ++it)
+                index->remove(it.key());
+            for (const QString& path : std::as_const(added))
+                index->add(path);
+            paths = index->allPaths();
+        }
+        QMetaObject::invokeMethod(
+            this, [this]() { this->runSearch(this->searchField->text()); },
+            Qt::QueuedConnection);
+
+        QMutexLocker lock(&this->snapshotMutex);
+        if (generation == this->indexGeneration)
+            FilenameIndex::saveSnapshot(root, paths);
+    });
+}
@@ -1,7 +1,23 @@
 #include "../Include/DownloadSorter/DownloadSorter.h"
+#include "../Include/DownloadSorter/AdaptiveConcurrency.h"
+#include "../Include/DownloadSorter/ColdStorage.h"
+#include "../Include/DownloadSorter/FilenameIndex.h"
+#include "../Include/DownloadSorter/SortMetrics.h"
+#include "../Include/DownloadSorter/TreeHasher.h"
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QPair>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <utility>
+#include <vector>
 
 // Keep constructor minimal; settings (mappings/ignore) are injected by
 // Dashboard
@@ -10,160 +26,762 @@ DownloadSorter::DownloadSorter(const QString& path) {
 }
 
 void DownloadSorter::run() {
-    this->createFoldersIfDoesntExist();
+    // Nothing moves in view mode, so none of the post-sort stages apply
+    if (this->viewMode) {
+        this->updateLinkView();
+        return;
+    }
+
+    if (!this->dryRun) {
+        this->createFoldersIfDoesntExist();
+        this->stats.load(this->downloadFolder.absolutePath());
+    }
+    this->categoriesTouched = false;
+    this->unmoved = 0;
 
     // Include directories in the contents list
-    this->contents = this->downloadFolder.entryInfoList(
-        QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    this->recalculateContents();
 
     const auto plan = this->evaluateCategory();
-    if (plan.isEmpty()) {
-        emit statusMessage(QStringLiteral("Nothing to move."));
-        emit progressRangeChanged(0, 1);
-        emit progressValueChanged(1);
+    if (this->dryRun) {
+        this->reportPlan(plan);
+        this->reportStatus(QStringLiteral("Dry run: %1 items would be moved.")
+                               .arg(plan.size()));
+        this->removeDuplicateFolders();
+        this->applyRetention();
         return;
     }
 
-    emit statusMessage(QStringLiteral("Moving %1 items...").arg(plan.size()));
-    this->moveContents(plan);
+    bool movedAny = false;
+    if (plan.isEmpty()) {
+        this->reportStatus(QStringLiteral("Nothing to move."));
+        this->reportRange(0, 1);
+        this->reportProgress(1);
+    } else {
+        this->reportStatus(
+            QStringLiteral("Moving %1 items...").arg(plan.size()));
+        const QMap<QString, QString> moved = this->moveContents(plan);
+        movedAny = !moved.isEmpty();
+        this->extractArchives(moved);
+    }
+
+    this->removeDuplicateFolders();
+    this->archiveColdFiles();
+    this->applyRetention();
+    this->updateStorageStats();
+    // A search index saved by another process (or window) no longer matches
+    if (movedAny || this->categoriesTouched)
+        FilenameIndex::invalidateSnapshot(this->downloadFolder.absolutePath());
+    if (this->categoriesTouched)
+        this->reportCategoriesChanged();
+}
+
+void DownloadSorter::reportRange(int minimum, int maximum) {
+    emit progressRangeChanged(minimum, maximum);
+    if (this->callbacks.progressRange)
+        this->callbacks.progressRange(minimum, maximum);
+}
+
+void DownloadSorter::reportProgress(int value) {
+    emit progressValueChanged(value);
+    if (this->callbacks.progress)
+        this->callbacks.progress(value);
+}
+
+void DownloadSorter::reportStatus(const QString& message) {
+    emit statusMessage(message);
+    if (this->callbacks.status)
+        this->callbacks.status(message);
+}
+
+void DownloadSorter::reportPlan(const QMap<QString, QString>& plan) {
+    emit planReady(plan);
+    if (this->callbacks.planReady)
+        this->callbacks.planReady(plan);
+}
+
+void DownloadSorter::reportMoved(const QMap<QString, QString>& moved) {
+    emit contentsMoved(moved);
+    if (this->callbacks.contentsMoved)
+        this->callbacks.contentsMoved(moved);
+}
+
+void DownloadSorter::reportCategoriesChanged() {
+    emit categoriesChanged();
+    if (this->callbacks.categoriesChanged)
+        this->callbacks.categoriesChanged();
+}
+
+bool DownloadSorter::stopRequested() const {
+    return this->isInterruptionRequested() ||
+           (this->callbacks.cancelled && this->callbacks.cancelled());
 }
 
 void DownloadSorter::recalculateContents() {
-    this->contents = this->downloadFolder.entryInfoList(
-        QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    this->contents = this->fs->list(this->downloadFolder.absolutePath());
 }
 
-int DownloadSorter::moveContents(QMap<QString, QString> filesPerCategory) {
+qint64 DownloadSorter::moveOne(const QString& src, const QString& dst) {
+    SortMetrics& metrics = SortMetrics::instance();
+    QElapsedTimer elapsed;
+    elapsed.start();
+    FileSystem::Entry srcInfo;
+    if (!this->fs->stat(src, &srcInfo)) {
+        qWarning() << "Failed to move" << src << ": it no longer exists";
+        metrics.recordFailure(ENOENT);
+        return -1;
+    }
+    // A directory rename only touches metadata; walking the tree for its
+    // size would cost more than the move, so it is sized after the sort
+    qint64 srcSize = srcInfo.isDir ? 0 : srcInfo.size;
+
+    // Ensure destination directory exists
+    const QString dstFolder = dst.left(dst.lastIndexOf('/'));
+    this->fs->mkpath(dstFolder);
+
+    // A folder identical to one already sorted shares that one's files; if
+    // they cannot be linked it is moved like any other
+    const QString original = this->linkSources.value(src);
+    const bool linked =
+        !original.isEmpty() && TreeHasher::linkTree(original, dst) == 0;
+    if (linked && this->fs->removeTree(src) != 0)
+        qWarning() << "Linked" << dst << "to" << original
+                   << "but could not remove all of" << src;
+
+    int error = linked ? 0 : this->fs->rename(src, dst);
+    const bool copied = error == EXDEV;
+    if (copied && srcInfo.isDir) {
+        // Whole trees (e.g. into Downloaded Folders) are copied in parallel;
+        // next to the copy, sizing the fresh tree costs next to nothing
+        error = this->fs->moveTree(src, dst);
+        if (error == 0)
+            srcSize = this->fs->totalSize(dst);
+    } else if (copied) {
+        // Fallback for cross-device moves: copy then remove. A source that
+        // cannot be removed would be sorted again as "name (1)", so the
+        // copy is taken back and the move counts as failed.
+        error = this->fs->copy(src, dst);
+        if (error == 0) {
+            error = this->fs->remove(src);
+            if (error != 0 && this->fs->remove(dst) != 0)
+                qWarning() << "Could not remove" << src << "or its copy"
+                           << dst;
+        }
+    }
+
+    if (error != 0) {
+        qWarning() << "Failed to move" << src << "to" << dst << ":"
+                   << qt_error_string(error);
+        metrics.recordFailure(error);
+        return -1;
+    }
+
+    // The category is the destination's folder name (above any shard
+    // folders), wherever its root is
+    const QString category = this->categoryByFolder.value(
+        dstFolder, dstFolder.mid(dstFolder.lastIndexOf('/') + 1));
+    metrics.recordMove(category, srcSize, copied, elapsed.nsecsElapsed());
+    QMutexLocker lock(&this->moveMutex);
+    if (srcInfo.isDir && !copied)
+        this->unsizedFolders.append({category, dst, srcInfo.modified});
+    else
+        this->stats.record(category, srcSize, srcInfo.modified);
+    return srcSize;
+}
+
+QMap<QString, QString> DownloadSorter::moveContents(
+    QMap<QString, QString> filesPerCategory) {
     const int total = filesPerCategory.size();
-    emit progressRangeChanged(0, total);
-    int done = 0;
-    emit progressValueChanged(done);
+    this->reportRange(0, total);
+    std::atomic<int> done{0};
+    this->reportProgress(0);
+    SortMetrics::instance().addQueued(total);
+    QMap<QString, QString> moved;
+    this->unsizedFolders.clear();
 
+    // Renames within the download folder's device are one queue; everything
+    // else is queued per destination device
+    const QByteArray localDevice =
+        this->fs->device(this->downloadFolder.absolutePath());
+    QList<MoveJob> local;
+    QMap<QByteArray, QList<MoveJob>> queues;
+    QHash<QString, QByteArray> deviceByFolder;
     for (auto i = filesPerCategory.begin(), end = filesPerCategory.end();
          i != end; ++i) {
-        const QString src = i.key();
-        const QString dst = i.value();
-
-        // Ensure destination directory exists
-        const QFileInfo dstInfo(dst);
-        QDir().mkpath(dstInfo.path());
-
-        bool ok = QFile::rename(src, dst);
-        if (!ok) {
-            // Fallback for cross-device moves: copy then remove
-            if (QFile::copy(src, dst)) {
-                QFile::remove(src);
-                ok = true;
-            }
+        const QString folder = i.value().left(i.value().lastIndexOf('/'));
+        auto device = deviceByFolder.find(folder);
+        if (device == deviceByFolder.end()) {
+            this->fs->mkpath(folder);
+            device = deviceByFolder.insert(folder, this->fs->device(folder));
         }
+        if (device.value() == localDevice)
+            local.append({i.key(), i.value()});
+        else
+            queues[device.value()].append({i.key(), i.value()});
+    }
+
+    // Up to limiter.maximum() workers drain `items` in order, while the
+    // limiter decides how many of them actually move something at a time
+    std::atomic<bool> cancelled{false};
+    auto process = [&](QThreadPool& pool, const QList<MoveJob>& items,
+                       AdaptiveConcurrency& limiter, bool copies,
+                       bool readAhead) {
+        auto next = std::make_shared<std::atomic<qsizetype>>(0);
+        const qsizetype workers =
+            std::min<qsizetype>(limiter.maximum(), items.size());
+        for (qsizetype w = 0; w < workers; ++w) {
+            pool.start([&, next, list = &items, gate = &limiter, copies,
+                        readAhead]() {
+                for (;;) {
+                    gate->acquire();
+                    const qsizetype k = (*next)++;
+                    if (k >= list->size() || cancelled ||
+                        this->stopRequested()) {
+                        cancelled = cancelled || k < list->size();
+                        gate->release(0, 0);
+                        return;
+                    }
+                    // Let the next source load while this one is copied
+                    if (readAhead && k + 1 < list->size())
+                        this->fs->willRead((*list)[k + 1].first);
 
-        if (!ok) {
-            qWarning() << "Failed to move" << src << "to" << dst << ":"
-                       << QFile(src).errorString();
+                    const MoveJob& item = (*list)[k];
+                    QElapsedTimer elapsed;
+                    elapsed.start();
+                    const qint64 bytes = this->moveOne(item.first, item.second);
+                    // Copies are paced by bytes, renames by count
+                    gate->release(elapsed.nsecsElapsed(),
+                                  bytes < 0 ? 0
+                                  : copies  ? std::max<qint64>(bytes, 1)
+                                            : 1);
+                    SortMetrics::instance().addQueued(-1);
+                    // Counted and reported under the lock, so the
+                    // progress callback sees one call at a time, in order
+                    QMutexLocker lock(&this->moveMutex);
+                    if (bytes >= 0)
+                        moved.insert(item.first, item.second);
+                    this->reportProgress(++done);
+                }
+            });
         }
+    };
 
-        done++;
-        emit progressValueChanged(done);
+    // Renames on the download folder's device go first
+    AdaptiveConcurrency renames(4, 1, 32);
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(renames.maximum());
+        process(pool, local, renames, false, false);
+        pool.waitForDone();
+    }
+
+    // Each destination device gets its own copy limiter, so different
+    // disks copy in parallel and each finds its own level. A queue in
+    // on-disk order is copied by a single worker: several would read from
+    // different places again, and each one's read-ahead would hint the item
+    // another is already copying.
+    const int copiesPerDevice = this->layoutOrderedCopies ? 1 : 8;
+    std::vector<std::unique_ptr<AdaptiveConcurrency>> copyLimits;
+    if (!cancelled && !queues.isEmpty()) {
+        QThreadPool pool;
+        if (this->layoutOrderedCopies) {
+            for (QList<MoveJob>& items : queues)
+                pool.start([this, &items]() { this->orderByLayout(items); });
+            pool.waitForDone();
+        }
+        pool.setMaxThreadCount(queues.size() * copiesPerDevice);
+        for (const QList<MoveJob>& items : std::as_const(queues)) {
+            copyLimits.push_back(std::make_unique<AdaptiveConcurrency>(
+                1, 1, copiesPerDevice));
+            process(pool, items, *copyLimits.back(), true,
+                    this->layoutOrderedCopies);
+        }
+        pool.waitForDone();
     }
+    const bool completed = !cancelled;
 
-    emit statusMessage(QStringLiteral("Done."));
-    return 0;
+    // Report the level each limiter settled at
+    const int renameLevel = local.isEmpty() ? 0 : renames.limit();
+    int copyLevel = 0;
+    for (const auto& limiter : copyLimits)
+        copyLevel = std::max(copyLevel, limiter->limit());
+    SortMetrics::instance().setConcurrency(renameLevel, copyLevel);
+    QStringList levels;
+    if (renameLevel > 0)
+        levels.append(QStringLiteral("%1 renames").arg(renameLevel));
+    if (copyLevel > 0)
+        levels.append(
+            QStringLiteral("up to %1 copies per drive").arg(copyLevel));
+
+    // Whatever a cancel left unattempted is no longer queued either
+    SortMetrics::instance().addQueued(done - total);
+    this->unmoved = total - moved.size();
+    this->reportMoved(moved);
+
+    // The levels are where the limiters ended up, not work still running
+    QString status;
+    if (!completed)
+        status = QStringLiteral("Cancelled after moving %1 of %2 items.")
+                     .arg(moved.size())
+                     .arg(total);
+    else if (this->unmoved > 0)
+        status = QStringLiteral("Done, but %1 of %2 items could not be "
+                                "moved.")
+                     .arg(this->unmoved)
+                     .arg(total);
+    else
+        status = QStringLiteral("Done.");
+    if (completed && !levels.isEmpty())
+        status += QStringLiteral(" Concurrency settled at %1.")
+                      .arg(levels.join(QStringLiteral(", ")));
+    this->reportStatus(status);
+    return moved;
 }
 
-QMap<QString, QString> DownloadSorter::evaluateCategory() {
-    QMap<QString, QString> filesPerCategory;
+// Sources sorted by physical position so a rotational disk reads them in one
+// sweep; jobs sharing a destination folder stay together (ordered by their
+// first source) so the writes are not scattered either
+void DownloadSorter::orderByLayout(QList<MoveJob>& jobs) const {
+    struct Placed {
+        quint64 offset;
+        MoveJob job;
+    };
+    QHash<QString, QVector<Placed>> byFolder;
+    for (const MoveJob& job : jobs) {
+        const QString folder = job.second.left(job.second.lastIndexOf('/'));
+        byFolder[folder].append({this->fs->physicalOffset(job.first), job});
+    }
 
-    for (auto it = this->contents.begin(); it != this->contents.end(); ++it) {
-        const QFileInfo content = *it;
-        const QString baseName = content.completeBaseName();
-        const QString suffixName = content.suffix();
-        const QString contentFileName = content.fileName();
+    QVector<QVector<Placed>> groups;
+    groups.reserve(byFolder.size());
+    for (QVector<Placed>& group : byFolder) {
+        std::sort(group.begin(), group.end(),
+                  [](const Placed& a, const Placed& b) {
+                      return a.offset < b.offset;
+                  });
+        groups.append(std::move(group));
+    }
+    std::sort(groups.begin(), groups.end(),
+              [](const QVector<Placed>& a, const QVector<Placed>& b) {
+                  return a.first().offset < b.first().offset;
+              });
 
-        if (blacklist.contains(contentFileName)) {
-            continue;
-        }
+    jobs.clear();
+    for (const QVector<Placed>& group : groups) {
+        for (const Placed& placed : group)
+            jobs.append(placed.job);
+    }
+}
 
-        // Ignore via regex (both files and directories)
-        bool shouldIgnore = false;
-        for (const QRegularExpression& regex : this->ignorePatterns) {
-            if (regex.isValid() && regex.match(contentFileName).hasMatch()) {
-                shouldIgnore = true;
-                break;
-            }
+QMap<QString, QString> DownloadSorter::evaluateCategory() {
+    QMap<QString, QString> filesPerCategory;
+    const RuleSet rules(this->fileTypesMap, this->ignorePatterns);
+    const QString root = this->downloadFolder.absolutePath();
+    this->categoryByFolder.clear();
+    this->duplicateSources.clear();
+    this->linkSources.clear();
+
+    // Only set up once some folder's name is taken
+    std::unique_ptr<TreeHasher> hasher;
+    // Sorted entries a folder called `name` (or "name (n)") clashes with:
+    // "name", "name (1)", ... for as long as they go
+    auto clashes = [this](const QString& folder, const QString& name) {
+        static const QRegularExpression numbered(
+            QStringLiteral("^(.+) \\(\\d+\\)$"));
+        const QRegularExpressionMatch match = numbered.match(name);
+        const QString base = match.hasMatch() ? match.captured(1) : name;
+        QStringList found;
+        QString path = folder + "/" + base;
+        for (int counter = 1; this->fs->exists(path); ++counter) {
+            found.append(path);
+            path = folder + "/" + base + " (" + QString::number(counter) + ")";
         }
-        if (shouldIgnore)
-            continue;
+        return found;
+    };
 
-        // Directories: move to "Downloaded Folders"
-        if (content.isDir()) {
-            const QString outputFolder = "/Downloaded Folders";
-            const QString originalLocation =
-                this->downloadFolder.absolutePath() + "/" + contentFileName;
-            const QString destinationFolder =
-                this->downloadFolder.absolutePath() + outputFolder;
-            QString renamedDestination =
-                destinationFolder + "/" + contentFileName;
-
-            int counter = 1;
-            while (QFileInfo(renamedDestination).exists()) {
-                const QString diff =
-                    contentFileName + " (" + QString::number(counter) + ")";
-                renamedDestination = destinationFolder + "/" + diff;
-                counter++;
-            }
+    const QStringList categories = categoryPaths(root, this->fileTypesMap,
+                                                 this->destinationRoots);
+    for (const FileSystem::Entry& content : this->contents) {
+        const QString& contentFileName = content.name;
 
-            filesPerCategory[originalLocation] = renamedDestination;
+        // Category folders, ignored and unrecognized entries stay put
+        const RuleSet::Decision decision =
+            rules.classify(contentFileName, content.isDir);
+        if (decision.outcome != RuleSet::Outcome::Move)
             continue;
-        }
 
-        // Files
-        const QString outputFolder = this->suffixToFolder(content);
-        if (outputFolder == "*")  // unrecognized file, skip
+        const QString originalLocation = root + "/" + contentFileName;
+        if (content.isDir && this->holdsCategory(originalLocation, categories))
             continue;
+        QString destinationFolder = this->categoryPath(decision.folder);
+        const ShardLayout layout = this->shardLayouts.value(decision.folder);
+        if (!layout.isFlat()) {
+            // Only dated layouts need the modification time
+            FileSystem::Entry info;
+            if (layout.kind == ShardLayout::Kind::YearMonth)
+                this->fs->stat(originalLocation, &info);
+            destinationFolder +=
+                "/" + layout.subfolder(contentFileName, info.modified);
+        }
+        this->categoryByFolder.insert(destinationFolder, decision.folder);
 
-        const QString originalLocation =
-            this->downloadFolder.absolutePath() + "/" + contentFileName;
-        const QString destinationFolder =
-            this->downloadFolder.absolutePath() + outputFolder;
-        QString renamedDestination = destinationFolder + "/" + contentFileName;
-
-        // Handle duplicates
-        int counter = 1;
-        while (QFileInfo(renamedDestination).exists()) {
-            const std::string diff = baseName.toStdString() + " (" +
-                                     std::to_string(counter) + ")." +
-                                     suffixName.toStdString();
-            renamedDestination =
-                destinationFolder + '/' + QString::fromStdString(diff);
-            counter++;
+        // A folder whose name is taken is often a second copy of the one
+        // that took it (the same archive extracted again)
+        if (content.isDir &&
+            this->duplicateFolders != DuplicateFolders::Rename &&
+            this->onRealDisk()) {
+            const QStringList taken =
+                clashes(destinationFolder, contentFileName);
+            QString original;
+            if (!taken.isEmpty()) {
+                if (!hasher)
+                    hasher = std::make_unique<TreeHasher>(
+                        root, QThread::idealThreadCount());
+                original = hasher->findIdentical(originalLocation, taken);
+            }
+            // The cached hashes that found it only rule folders out; before
+            // one is deleted or replaced by links, both are read in full
+            if (!original.isEmpty() &&
+                this->duplicateFolders != DuplicateFolders::Skip &&
+                !hasher->verifyIdentical(originalLocation, original))
+                original.clear();
+            if (!original.isEmpty()) {
+                if (this->duplicateFolders == DuplicateFolders::Skip)
+                    continue;
+                if (this->duplicateFolders == DuplicateFolders::Remove) {
+                    this->duplicateSources.append(originalLocation);
+                    continue;
+                }
+                this->linkSources.insert(originalLocation, original);
+            }
         }
 
-        filesPerCategory[originalLocation] = renamedDestination;
+        // Handle duplicates: "name (n)" for directories, "base (n).ext" for
+        // files
+        filesPerCategory[originalLocation] = this->fs->freePath(
+            destinationFolder, contentFileName, content.isDir);
     }
 
+    if (hasher)
+        hasher->save();
     return filesPerCategory;
 }
 
-QString DownloadSorter::suffixToFolder(QFileInfo content) {
-    const QString suffix = content.suffix().toLower();
-    for (auto it = this->fileTypesMap.begin(), end = this->fileTypesMap.end();
-         it != end; ++it) {
-        if (it.value().contains(suffix)) {
-            return "/" + it.key();
+void DownloadSorter::updateLinkView() {
+    const QString root = this->downloadFolder.absolutePath();
+    const QString view = QDir::cleanPath(
+        this->viewRoot.isEmpty() ? LinkView::defaultRoot(root)
+                                 : QDir(this->viewRoot).absolutePath());
+    const RuleSet rules(this->fileTypesMap, this->ignorePatterns);
+
+    // A sync removes what it considers stale links, so the view must not
+    // share any folder with the downloads or the sorted categories
+    const QStringList categories = categoryPaths(root, this->fileTypesMap,
+                                                 this->destinationRoots);
+    for (const QString& path : QStringList(root) + categories) {
+        if (pathsOverlap(view, path)) {
+            qWarning() << "View folder" << view << "overlaps" << path;
+            this->reportStatus(
+                QStringLiteral("Not updating the view: %1 overlaps %2.")
+                    .arg(view, path));
+            return;
         }
     }
-    return "*";
+
+    // Same decisions as a sort, but aimed at the view; names are unique in
+    // the download folder so no "(n)" renaming is needed
+    QMap<QString, QString> plan;
+    QMap<QString, QString> links;
+    this->recalculateContents();
+    for (const FileSystem::Entry& content : this->contents) {
+        const QString source = root + "/" + content.name;
+        const RuleSet::Decision decision =
+            rules.classify(content.name, content.isDir);
+        if (decision.outcome != RuleSet::Outcome::Move ||
+            (content.isDir && holdsCategory(source, categories)))
+            continue;
+        const QString target =
+            view + "/" + decision.folder + "/" + content.name;
+        plan.insert(source, target);
+        links.insert(target, source);
+    }
+
+    if (this->dryRun) {
+        this->reportPlan(plan);
+        this->reportStatus(QStringLiteral("Dry run: %1 items would be linked "
+                                          "into %2.")
+                               .arg(plan.size())
+                               .arg(view));
+        return;
+    }
+
+    this->reportStatus(QStringLiteral("Updating view in %1...").arg(view));
+    this->reportRange(0, 0);
+    const LinkView::Result r = LinkView(view, root).sync(links);
+    this->reportRange(0, 1);
+    this->reportProgress(1);
+
+    if (r.failed > 0) {
+        qWarning() << "View update failed for" << r.failed << "items";
+    }
+    if (r.kept > 0)
+        qWarning() << "View: left" << r.kept << "entries it did not create";
+    this->reportStatus(QStringLiteral("Done. View: %1 hardlinks and %2 "
+                                      "symlinks added, %3 removed, %4 "
+                                      "unchanged.")
+                           .arg(r.hardlinked)
+                           .arg(r.symlinked)
+                           .arg(r.removed)
+                           .arg(r.unchanged));
 }
 
 void DownloadSorter::createFoldersIfDoesntExist() {
-    // Create built-in folders from blacklist (if missing)
+    // Create built-in folders from blacklist (if missing), each under its
+    // configured destination root
     for (qsizetype i = 0; i < this->blacklist.length(); i++) {
-        const QString folder =
-            this->downloadFolder.absolutePath() + "/" + this->blacklist[i];
-        QDir folder_dir(folder);
-        if (!folder_dir.exists()) {
-            std::filesystem::create_directory(
-                folder_dir.absolutePath().toStdString());
-        }
+        const QString folder = this->categoryPath(this->blacklist[i]);
+        if (const int error = this->fs->mkpath(folder))
+            qWarning() << "Could not create" << folder << ":"
+                       << qt_error_string(error);
+    }
+}
+
+QString DownloadSorter::categoryPath(
+    const QString& root,
+    const QString& category,
+    const QMap<QString, QString>& destinationRoots) {
+    const QString base = destinationRoots.value(category);
+    return QDir(base.isEmpty() ? root : base).absoluteFilePath(category);
+}
+
+bool DownloadSorter::holdsCategory(const QString& path,
+                                   const QStringList& categories) {
+    return std::any_of(categories.begin(), categories.end(),
+                       [&path](const QString& category) {
+                           return pathsOverlap(path, category);
+                       });
+}
+
+bool DownloadSorter::pathsOverlap(const QString& a, const QString& b) {
+#ifdef Q_OS_WIN
+    const Qt::CaseSensitivity cs = Qt::CaseInsensitive;
+#else
+    const Qt::CaseSensitivity cs = Qt::CaseSensitive;
+#endif
+    const QString x = QDir::cleanPath(QDir(a).absolutePath());
+    const QString y = QDir::cleanPath(QDir(b).absolutePath());
+    // "/" already ends in the separator
+    auto inside = [cs](const QString& path, const QString& dir) {
+        return path.startsWith(dir.endsWith('/') ? dir : dir + '/', cs);
+    };
+    return x.compare(y, cs) == 0 || inside(x, y) || inside(y, x);
+}
+
+QStringList DownloadSorter::categoryPaths(
+    const QString& root,
+    const QMap<QString, QList<QString>>& mappings,
+    const QMap<QString, QString>& destinationRoots) {
+    QStringList paths;
+    for (const QString& folder : managedFolders(mappings))
+        paths.append(categoryPath(root, folder, destinationRoots));
+    return paths;
+}
+
+QList<QString> DownloadSorter::managedFolders(
+    const QMap<QString, QList<QString>>& mappings) {
+    QList<QString> folders = blacklist;
+    for (auto it = mappings.begin(), end = mappings.end(); it != end; ++it) {
+        if (!folders.contains(it.key()))
+            folders.append(it.key());
+    }
+    return folders;
+}
+
+void DownloadSorter::extractArchives(const QMap<QString, QString>& moved) {
+    if (!this->extractSortedArchives || this->stopRequested())
+        return;
+
+    QStringList archives;
+    for (const QString& dst : moved) {
+        const QString folder = dst.left(dst.lastIndexOf('/'));
+        if (this->categoryByFolder.value(folder) ==
+                QLatin1String("Downloaded Archives") &&
+            ArchiveExtractor::isArchive(dst))
+            archives.append(dst);
+    }
+    if (archives.isEmpty())
+        return;
+
+    this->reportStatus(
+        QStringLiteral("Extracting %1 archives...").arg(archives.size()));
+    const ArchiveExtractor::Result r =
+        ArchiveExtractor(QThread::idealThreadCount())
+            .extract(archives, [this]() {
+                return this->stopRequested();
+            });
+    if (r.failed > 0 || r.skipped > 0)
+        qWarning() << "Archive extraction:" << r.failed << "failed,"
+                   << r.skipped << "skipped";
+    // The extracted folders are new items in the category
+    if (r.extracted > 0) {
+        this->stats.invalidate();
+        this->categoriesTouched = true;
+    }
+    this->reportStatus(QStringLiteral("Done. Extracted %1 archives (%2 "
+                                      "skipped, %3 failed).")
+                           .arg(r.extracted)
+                           .arg(r.skipped)
+                           .arg(r.failed));
+}
+
+bool DownloadSorter::onRealDisk() const {
+    return dynamic_cast<const PosixFileSystem*>(this->fs.get()) != nullptr;
+}
+
+void DownloadSorter::removeDuplicateFolders() {
+    const int total = this->duplicateSources.size();
+    if (total == 0)
+        return;
+    if (this->dryRun) {
+        this->reportStatus(QStringLiteral("Dry run: %1 folders identical to "
+                                          "sorted ones would be deleted.")
+                               .arg(total));
+        return;
+    }
+
+    // One tree per task
+    std::atomic<int> failed{0};
+    QThreadPool pool;
+    for (const QString& path : std::as_const(this->duplicateSources)) {
+        pool.start([this, &failed, path]() {
+            if (this->fs->removeTree(path) != 0)
+                failed++;
+        });
+    }
+    pool.waitForDone();
+    if (failed > 0)
+        qWarning() << "Could not delete" << failed << "duplicate folders";
+    this->reportStatus(
+        QStringLiteral("Done. Deleted %1 folders identical to sorted ones.")
+            .arg(total - failed));
+}
+
+void DownloadSorter::archiveColdFiles() {
+    if (this->coldStorageAgeDays <= 0)
+        return;
+
+    this->reportStatus(QStringLiteral("Compressing files untouched for %1 "
+                                      "days...")
+                           .arg(this->coldStorageAgeDays));
+
+    // Only runs once moveContents is done, and its workers run at the lowest
+    // priority on half the cores so interactive use stays responsive
+    const int threads = qMax(1, QThread::idealThreadCount() / 2);
+    ColdStorage::Result total;
+    for (const QString& folder : managedFolders(this->fileTypesMap)) {
+        if (this->stopRequested())
+            break;
+        ColdStorage store(this->categoryPath(folder));
+        const ColdStorage::Result r =
+            store.archiveOlderThan(this->coldStorageAgeDays, threads);
+        total.archived += r.archived;
+        total.failed += r.failed;
+        total.bytesIn += r.bytesIn;
+        total.bytesOut += r.bytesOut;
+    }
+
+    if (total.failed > 0) {
+        qWarning() << "Cold storage skipped" << total.failed << "files";
+    }
+    // Archived files left their category folders; recount on the next pass
+    if (total.archived > 0) {
+        this->stats.invalidate();
+        this->categoriesTouched = true;
+    }
+    this->reportStatus(
+        QStringLiteral("Done. Compressed %1 old files (%2 MB saved).")
+            .arg(total.archived)
+            .arg((total.bytesIn - total.bytesOut) / (1024 * 1024)));
+}
+
+void DownloadSorter::applyRetention() {
+    bool active = false;
+    for (const RetentionRule& rule : this->retentionRules)
+        active = active || rule.isActive();
+    if (!active || this->stopRequested())
+        return;
+
+    const RetentionSweeper sweeper(this->downloadFolder.absolutePath(),
+                                   this->retentionRules,
+                                   this->destinationRoots,
+                                   this->shardLayouts);
+    const int threads = QThread::idealThreadCount();
+    if (this->dryRun) {
+        const RetentionSweeper::Result r = sweeper.plan(threads);
+        qint64 bytes = 0;
+        for (const RetentionSweeper::Item& item : r.victims)
+            bytes += item.size;
+        this->reportStatus(
+            QStringLiteral("Dry run: retention would remove %1 items (%2 MB).")
+                .arg(r.victims.size())
+                .arg(bytes / (1024 * 1024)));
+        return;
+    }
+
+    this->reportStatus(QStringLiteral("Applying retention rules..."));
+    const RetentionSweeper::Result r = sweeper.sweep(threads);
+    if (r.failed > 0) {
+        qWarning() << "Retention could not remove" << r.failed << "items";
+    }
+    // Removed items are not tracked per category; recount on the next pass
+    if (r.removed > 0) {
+        this->stats.invalidate();
+        this->categoriesTouched = true;
+    }
+    this->reportStatus(
+        QStringLiteral("Done. Retention removed %1 items (%2 MB freed).")
+            .arg(r.removed)
+            .arg(r.bytesFreed / (1024 * 1024)));
+}
+
+void DownloadSorter::updateStorageStats() {
+    // The incremental numbers drift when files are changed by hand, so
+    // re-walk the category folders every so often; that also sizes the
+    // folders this sort moved
+    if (this->stats.needsReconcile() && !this->stopRequested()) {
+        this->stats.reconcile(
+            categoryPaths(this->downloadFolder.absolutePath(),
+                          this->fileTypesMap, this->destinationRoots),
+            this->shardLayouts);
+    } else {
+        this->recordMovedFolders();
+    }
+    this->unsizedFolders.clear();
+    this->stats.save();
+}
+
+void DownloadSorter::recordMovedFolders() {
+    if (this->unsizedFolders.isEmpty())
+        return;
+    // Counted without a size; the next sort's re-walk fills it in
+    if (this->stopRequested()) {
+        for (const MovedFolder& folder : std::as_const(this->unsizedFolders))
+            this->stats.record(folder.category, 0, folder.modified);
+        this->stats.invalidate();
+        return;
+    }
+
+    // One tree per task, now that nothing is waiting on the moves
+    std::vector<qint64> sizes(this->unsizedFolders.size());
+    QThreadPool pool;
+    for (qsizetype i = 0; i < this->unsizedFolders.size(); ++i) {
+        pool.start([this, &sizes, i]() {
+            sizes[i] = this->fs->totalSize(this->unsizedFolders[i].path);
+        });
+    }
+    pool.waitForDone();
+    for (qsizetype i = 0; i < this->unsizedFolders.size(); ++i) {
+        const MovedFolder& folder = this->unsizedFolders[i];
+        this->stats.record(folder.category, sizes[i], folder.modified);
     }
 }
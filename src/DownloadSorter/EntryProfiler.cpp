@@ -0,0 +1,327 @@
+#include "../Include/DownloadSorter/EntryProfiler.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QThreadPool>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#ifndef Q_OS_WIN
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Bytes read from each unmatched file; enough for tar's "ustar" at 257
+constexpr qint64 headSize = 264;
+// Entries classified per pool task
+constexpr qsizetype chunkSize = 4096;
+// A suffix is suggested once this share of its bytes is a single family
+constexpr double dominantShare = 0.9;
+
+const char archives[] = "Downloaded Archives";
+const char audios[] = "Downloaded Audios";
+const char documents[] = "Downloaded Documents";
+const char fonts[] = "Downloaded Fonts";
+const char images[] = "Downloaded Images";
+const char programs[] = "Downloaded Programs";
+const char videos[] = "Downloaded Videos";
+
+struct Signature {
+    int offset;
+    const char* bytes;
+    int length;
+    const char* family;
+    const char* folder;  // null: no category fits
+};
+
+// Checked in order; RIFF and ISO media containers are told apart in code
+const Signature signatures[] = {
+    {0, "%PDF-", 5, "pdf", documents},
+    {0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1", 8, "ole2", documents},
+    {0, "{\\rtf", 5, "rtf", documents},
+    {0, "PK\x03\x04", 4, "zip", archives},
+    {0, "Rar!\x1A\x07", 6, "rar", archives},
+    {0, "7z\xBC\xAF\x27\x1C", 6, "7z", archives},
+    {0, "\x1F\x8B", 2, "gzip", archives},
+    {0, "BZh", 3, "bzip2", archives},
+    {0, "\xFD" "7zXZ", 5, "xz", archives},
+    {0, "\x28\xB5\x2F\xFD", 4, "zstd", archives},
+    {257, "ustar", 5, "tar", archives},
+    {0, "\x89PNG", 4, "png", images},
+    {0, "\xFF\xD8\xFF", 3, "jpeg", images},
+    {0, "GIF8", 4, "gif", images},
+    {0, "8BPS", 4, "psd", images},
+    {0, "\x1A\x45\xDF\xA3", 4, "matroska", videos},
+    {0, "\x00\x00\x01\xBA", 4, "mpeg", videos},
+    {0, "ID3", 3, "mp3", audios},
+    {0, "\xFF\xFB", 2, "mp3", audios},
+    {0, "fLaC", 4, "flac", audios},
+    {0, "OggS", 4, "ogg", audios},
+    {0, "MZ", 2, "pe", programs},
+    {0, "\x7F" "ELF", 4, "elf", programs},
+    {0, "\xCF\xFA\xED\xFE", 4, "mach-o", programs},
+    {0, "\xCA\xFE\xBA\xBE", 4, "mach-o", programs},
+    {0, "wOFF", 4, "woff", fonts},
+    {0, "wOF2", 4, "woff", fonts},
+    {0, "OTTO", 4, "opentype", fonts},
+    {0, "\x00\x01\x00\x00\x00", 5, "truetype", fonts},
+    {0, "SQLite format 3", 15, "sqlite", nullptr},
+    {0, "#!", 2, "script", nullptr},
+};
+
+bool startsWithAt(const QByteArray& head, int offset, const char* bytes,
+                  int length) {
+    return head.size() >= offset + length &&
+           std::memcmp(head.constData() + offset, bytes, length) == 0;
+}
+
+bool readHead(const QString& path, QByteArray* head) {
+#ifndef Q_OS_WIN
+    const int fd =
+        ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    head->resize(headSize);
+    ssize_t n;
+    do {
+        n = ::pread(fd, head->data(), head->size(), 0);
+    } while (n < 0 && errno == EINTR);
+    ::close(fd);
+    if (n < 0)
+        return false;
+    head->truncate(n);
+    return true;
+#else
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    *head = file.read(headSize);
+    return true;
+#endif
+}
+
+// Leading run of letters when something else follows ("IMG" of
+// "IMG_2041.heic"), lower-cased so "Screenshot" and "screenshot" add up
+QString nameWord(const QString& name) {
+    qsizetype n = 0;
+    while (n < name.size() && name[n].isLetter())
+        ++n;
+    if (n < 2 || n == name.size())
+        return QString();
+    return name.left(n).toLower();
+}
+
+// Suffixes that make sense as a mapping ("cbz", "mp4"), as opposed to the
+// tail of a name with a dot in it
+bool isMappable(const QString& suffix) {
+    if (suffix.isEmpty() || suffix.size() > 10)
+        return false;
+    return std::all_of(suffix.begin(), suffix.end(),
+                       [](QChar c) { return c.isLetterOrNumber(); });
+}
+
+struct Tally {
+    qint64 count = 0;
+    qint64 bytes = 0;
+
+    void add(qint64 n, qint64 size) {
+        this->count += n;
+        this->bytes += size;
+    }
+};
+
+// What one chunk (and in the end, all of them) found
+struct Partial {
+    qint64 entries = 0;
+    qint64 ignored = 0;
+    Tally unmatched;
+    QHash<QString, Tally> suffixes;
+    QHash<QString, Tally> prefixes;
+    QHash<QString, Tally> families;
+    // Suffix -> family -> tally, for the suggestions
+    QHash<QString, QHash<QString, Tally>> familiesBySuffix;
+    QHash<QString, QString> folderByFamily;
+
+    static void merge(QHash<QString, Tally>& into,
+                      const QHash<QString, Tally>& from) {
+        for (auto it = from.cbegin(), end = from.cend(); it != end; ++it)
+            into[it.key()].add(it->count, it->bytes);
+    }
+
+    void add(const Partial& other) {
+        this->entries += other.entries;
+        this->ignored += other.ignored;
+        this->unmatched.add(other.unmatched.count, other.unmatched.bytes);
+        merge(this->suffixes, other.suffixes);
+        merge(this->prefixes, other.prefixes);
+        merge(this->families, other.families);
+        for (auto it = other.familiesBySuffix.cbegin(),
+                  end = other.familiesBySuffix.cend();
+             it != end; ++it)
+            merge(this->familiesBySuffix[it.key()], it.value());
+        this->folderByFamily.insert(other.folderByFamily);
+    }
+};
+
+QVector<EntryProfiler::Row> rowsOf(const QHash<QString, Tally>& tallies) {
+    QVector<EntryProfiler::Row> rows;
+    rows.reserve(tallies.size());
+    for (auto it = tallies.cbegin(), end = tallies.cend(); it != end; ++it)
+        rows.append({it.key(), it->count, it->bytes});
+    std::sort(rows.begin(), rows.end(),
+              [](const EntryProfiler::Row& a, const EntryProfiler::Row& b) {
+                  if (a.bytes != b.bytes)
+                      return a.bytes > b.bytes;
+                  if (a.count != b.count)
+                      return a.count > b.count;
+                  return a.key < b.key;
+              });
+    return rows;
+}
+}  // namespace
+
+EntryProfiler::EntryProfiler(const RuleSet& rules,
+                             std::shared_ptr<FileSystem> fileSystem)
+    : rules(rules), fs(std::move(fileSystem)) {}
+
+QString EntryProfiler::family(const QByteArray& head, QString* folder) {
+    auto found = [folder](const char* family, const char* category) {
+        if (folder)
+            *folder = category ? QString::fromLatin1(category) : QString();
+        return QString::fromLatin1(family);
+    };
+
+    if (head.isEmpty())
+        return found("empty", nullptr);
+    if (startsWithAt(head, 0, "RIFF", 4)) {
+        if (startsWithAt(head, 8, "WEBP", 4))
+            return found("webp", images);
+        if (startsWithAt(head, 8, "WAVE", 4))
+            return found("wav", audios);
+        if (startsWithAt(head, 8, "AVI ", 4))
+            return found("avi", videos);
+    }
+    if (startsWithAt(head, 4, "ftyp", 4)) {
+        for (const char* brand : {"heic", "heix", "mif1", "avif"}) {
+            if (startsWithAt(head, 8, brand, 4))
+                return found("heif", images);
+        }
+        if (startsWithAt(head, 8, "M4A ", 4))
+            return found("m4a", audios);
+        return found("mp4", videos);
+    }
+    for (const Signature& s : signatures) {
+        if (startsWithAt(head, s.offset, s.bytes, s.length))
+            return found(s.family, s.folder);
+    }
+    // No NUL in the first bytes is as good a test for text as any
+    if (!head.contains('\0'))
+        return found("text", nullptr);
+    return found("data", nullptr);
+}
+
+EntryProfiler::Report EntryProfiler::profile(const QStringList& roots,
+                                             int maxThreads) const {
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, maxThreads));
+
+    // Every root is listed on its own thread
+    QVector<QVector<FileSystem::Entry>> listings(roots.size());
+    for (qsizetype r = 0; r < roots.size(); ++r) {
+        pool.start([this, &roots, &listings, r]() {
+            listings[r] = this->fs->list(roots[r]);
+        });
+    }
+    pool.waitForDone();
+
+    // Then the entries are classified in chunks, each tallied on its own
+    // and merged once at the end of the chunk
+    QMutex mutex;
+    Partial total;
+    for (qsizetype r = 0; r < roots.size(); ++r) {
+        const QVector<FileSystem::Entry>* entries = &listings[r];
+        const QString root = roots[r];
+        for (qsizetype start = 0; start < entries->size();
+             start += chunkSize) {
+            pool.start([this, &mutex, &total, entries, root, start]() {
+                Partial part;
+                const qsizetype end =
+                    std::min(start + chunkSize, entries->size());
+                for (qsizetype i = start; i < end; ++i) {
+                    const FileSystem::Entry& entry = (*entries)[i];
+                    part.entries++;
+                    const RuleSet::Decision decision =
+                        this->rules.classify(entry.name, entry.isDir);
+                    if (decision.outcome == RuleSet::Outcome::Ignored)
+                        part.ignored++;
+                    if (decision.outcome != RuleSet::Outcome::Unrecognized)
+                        continue;
+
+                    const QString path = root + '/' + entry.name;
+                    FileSystem::Entry info;
+                    const qint64 size =
+                        this->fs->stat(path, &info) ? info.size : 0;
+                    QByteArray head;
+                    QString folder;
+                    const QString kind =
+                        readHead(path, &head) ? family(head, &folder)
+                                              : QStringLiteral("unreadable");
+                    const qsizetype dot = entry.name.lastIndexOf('.');
+                    const QString suffix =
+                        dot < 0 ? QString() : entry.name.mid(dot + 1).toLower();
+                    const QString word = nameWord(entry.name);
+
+                    part.unmatched.add(1, size);
+                    part.suffixes[suffix].add(1, size);
+                    if (!word.isEmpty())
+                        part.prefixes[word].add(1, size);
+                    part.families[kind].add(1, size);
+                    part.familiesBySuffix[suffix][kind].add(1, size);
+                    if (!folder.isEmpty())
+                        part.folderByFamily.insert(kind, folder);
+                }
+                QMutexLocker lock(&mutex);
+                total.add(part);
+            });
+        }
+    }
+    pool.waitForDone();
+
+    Report report;
+    report.entries = total.entries;
+    report.ignored = total.ignored;
+    report.unmatched = total.unmatched.count;
+    report.unmatchedBytes = total.unmatched.bytes;
+    report.suffixes = rowsOf(total.suffixes);
+    report.prefixes = rowsOf(total.prefixes);
+    report.families = rowsOf(total.families);
+
+    for (auto it = total.familiesBySuffix.cbegin(),
+              end = total.familiesBySuffix.cend();
+         it != end; ++it) {
+        if (!isMappable(it.key()))
+            continue;
+        const Tally all = total.suffixes.value(it.key());
+        const QVector<Row> kinds = rowsOf(it.value());
+        const Row& top = kinds.first();
+        // Empty files say nothing; go by count when there are no bytes
+        const bool dominant = all.bytes > 0
+                                  ? top.bytes >= all.bytes * dominantShare
+                                  : top.count >= all.count * dominantShare;
+        const QString folder = total.folderByFamily.value(top.key);
+        if (dominant && !folder.isEmpty())
+            report.suggestions.append({it.key(), folder, all.count, all.bytes});
+    }
+    std::sort(report.suggestions.begin(), report.suggestions.end(),
+              [](const Suggestion& a, const Suggestion& b) {
+                  if (a.bytes != b.bytes)
+                      return a.bytes > b.bytes;
+                  return a.suffix < b.suffix;
+              });
+    return report;
+}
@@ -0,0 +1,365 @@
+#include "../Include/DownloadSorter/FileSystem.h"
+#include "../Include/DownloadSorter/StorageStats.h"
+#include "../Include/DownloadSorter/TreeTransfer.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QThread>
+
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#ifdef Q_OS_WIN
+#include <QtCore/QStorageInfo>
+#endif
+
+namespace {
+#ifndef Q_OS_WIN
+// Read/write chunk for copies between devices
+constexpr size_t copyBufferSize = 1 << 20;
+
+QByteArray native(const QString& path) {
+    return QFile::encodeName(path);
+}
+#endif
+}  // namespace
+
+QString FileSystem::freePath(const QString& folder,
+                             const QString& name,
+                             bool isDir) const {
+    QString path = folder + "/" + name;
+    // Split at the last dot, like QFileInfo::completeBaseName()
+    const qsizetype dot = name.lastIndexOf('.');
+    const QString baseName = name.left(dot);
+    const QString suffix = dot < 0 ? QString() : name.mid(dot + 1);
+    for (int counter = 1; this->exists(path); ++counter) {
+        const QString diff =
+            isDir ? name + " (" + QString::number(counter) + ")"
+                  : baseName + " (" + QString::number(counter) + ")." + suffix;
+        path = folder + "/" + diff;
+    }
+    return path;
+}
+
+int FileSystem::moveTree(const QString& from, const QString& to) {
+    if (this->exists(to))
+        return EEXIST;
+
+    // Breadth first, so every directory exists before its entries
+    QStringList dirs = {QString()};
+    QStringList files;
+    int error = 0;
+    for (qsizetype i = 0; i < dirs.size() && error == 0; ++i) {
+        error = this->mkpath(to + dirs[i]);
+        for (const Entry& entry : this->list(from + dirs[i]))
+            (entry.isDir ? dirs : files).append(dirs[i] + "/" + entry.name);
+    }
+    for (qsizetype i = 0; i < files.size() && error == 0; ++i)
+        error = this->copy(from + files[i], to + files[i]);
+
+    // Undo the copy on failure, or delete the source once it is complete
+    const QString& victim = error == 0 ? from : to;
+    for (const QString& file : files)
+        this->remove(victim + file);
+    for (qsizetype i = dirs.size() - 1; i >= 0; --i)
+        this->remove(victim + dirs[i]);
+    return error;
+}
+
+int FileSystem::removeTree(const QString& path) {
+    Entry info;
+    if (!this->stat(path, &info))
+        return ENOENT;
+    int error = 0;
+    if (info.isDir) {
+        for (const Entry& entry : this->list(path)) {
+            const int e = this->removeTree(path + "/" + entry.name);
+            if (error == 0)
+                error = e;
+        }
+    }
+    const int e = this->remove(path);
+    return error != 0 ? error : e;
+}
+
+std::shared_ptr<FileSystem> FileSystem::local() {
+    static const std::shared_ptr<FileSystem> instance =
+        std::make_shared<PosixFileSystem>();
+    return instance;
+}
+
+QVector<FileSystem::Entry> PosixFileSystem::list(const QString& dir) const {
+    QVector<Entry> entries;
+#ifndef Q_OS_WIN
+    DIR* handle = ::opendir(native(dir).constData());
+    if (!handle)
+        return entries;
+    const int fd = ::dirfd(handle);
+    while (const dirent* d = ::readdir(handle)) {
+        // Hidden entries, "." and ".." (QDir's default filter skips these)
+        if (d->d_name[0] == '.')
+            continue;
+        Entry entry;
+        if (d->d_type == DT_DIR || d->d_type == DT_REG) {
+            entry.isDir = d->d_type == DT_DIR;
+        } else if (d->d_type == DT_LNK || d->d_type == DT_UNKNOWN) {
+            // Resolve links; dangling ones are left out
+            struct stat st;
+            if (::fstatat(fd, d->d_name, &st, 0) != 0 ||
+                !(S_ISDIR(st.st_mode) || S_ISREG(st.st_mode)))
+                continue;
+            entry.isDir = S_ISDIR(st.st_mode);
+        } else {
+            continue;  // devices, sockets, fifos
+        }
+        entry.name = QFile::decodeName(d->d_name);
+        entries.append(entry);
+    }
+    ::closedir(handle);
+#else
+    for (const QFileInfo& info : QDir(dir).entryInfoList(
+             QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot))
+        entries.append({info.fileName(), info.isDir()});
+#endif
+    return entries;
+}
+
+bool PosixFileSystem::stat(const QString& path, Entry* entry) const {
+#ifndef Q_OS_WIN
+    struct stat st;
+    if (::stat(native(path).constData(), &st) != 0)
+        return false;
+    if (entry) {
+        entry->name = QFileInfo(path).fileName();
+        entry->isDir = S_ISDIR(st.st_mode);
+        entry->size = st.st_size;
+        entry->modified =
+            QDateTime::fromSecsSinceEpoch(static_cast<qint64>(st.st_mtime));
+    }
+    return true;
+#else
+    const QFileInfo info(path);
+    if (!info.exists())
+        return false;
+    if (entry)
+        *entry = {info.fileName(), info.isDir(), info.size(),
+                  info.lastModified()};
+    return true;
+#endif
+}
+
+qint64 PosixFileSystem::totalSize(const QString& path) const {
+    return StorageStats::entrySize(path);
+}
+
+QByteArray PosixFileSystem::device(const QString& path) const {
+#ifndef Q_OS_WIN
+    // The nearest existing ancestor decides where `path` would be created
+    QString existing = QDir::cleanPath(path);
+    struct stat st;
+    while (::stat(native(existing).constData(), &st) != 0) {
+        const qsizetype slash = existing.lastIndexOf('/');
+        if (slash <= 0)
+            return QByteArray("/");
+        existing.truncate(slash);
+    }
+    return QByteArray::number(static_cast<quint64>(st.st_dev));
+#else
+    return QStorageInfo(path).device();
+#endif
+}
+
+quint64 PosixFileSystem::physicalOffset(const QString& path) const {
+#ifndef Q_OS_WIN
+    const int fd = ::open(native(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    quint64 offset = 0;
+#ifdef Q_OS_LINUX
+    // Room for the header and a single extent: only the first one matters
+    alignas(struct fiemap) char
+        request[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+    auto* map = reinterpret_cast<struct fiemap*>(request);
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    if (::ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0)
+        offset = map->fm_extents[0].fe_physical;
+#endif
+    // Inodes are allocated near their data on most filesystems
+    struct stat st;
+    if (offset == 0 && ::fstat(fd, &st) == 0)
+        offset = static_cast<quint64>(st.st_ino);
+    ::close(fd);
+    return offset;
+#else
+    Q_UNUSED(path);
+    return 0;
+#endif
+}
+
+void PosixFileSystem::willRead(const QString& path) const {
+#ifdef Q_OS_LINUX
+    const int fd = ::open(native(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    // Starts the read in the background; the page cache keeps it after close
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+#else
+    Q_UNUSED(path);
+#endif
+}
+
+int PosixFileSystem::mkpath(const QString& path) {
+#ifndef Q_OS_WIN
+    const QString clean = QDir::cleanPath(path);
+    const QByteArray name = native(clean);
+    if (::mkdir(name.constData(), 0777) == 0)
+        return 0;
+    struct stat st;
+    if (errno == EEXIST)
+        return ::stat(name.constData(), &st) == 0 && S_ISDIR(st.st_mode)
+                   ? 0
+                   : ENOTDIR;
+    if (errno != ENOENT)
+        return errno;
+
+    // Parent missing: create it first
+    const qsizetype slash = clean.lastIndexOf('/');
+    if (slash <= 0)
+        return ENOENT;
+    if (const int error = this->mkpath(clean.left(slash)))
+        return error;
+    return ::mkdir(name.constData(), 0777) == 0 || errno == EEXIST ? 0
+                                                                   : errno;
+#else
+    return QDir().mkpath(path) ? 0 : EACCES;
+#endif
+}
+
+int PosixFileSystem::rename(const QString& from, const QString& to) {
+#ifndef Q_OS_WIN
+    // rename(2) would silently replace `to`
+    struct stat st;
+    if (::lstat(native(to).constData(), &st) == 0)
+        return EEXIST;
+    return ::rename(native(from).constData(), native(to).constData()) == 0
+               ? 0
+               : errno;
+#else
+    if (QFileInfo::exists(to))
+        return EEXIST;
+    // QFile::rename copies across volumes itself; leave that to the caller
+    if (QStorageInfo(from).device() != this->device(to))
+        return EXDEV;
+    return QFile::rename(from, to) ? 0 : EACCES;
+#endif
+}
+
+int PosixFileSystem::copy(const QString& from, const QString& to) {
+#ifndef Q_OS_WIN
+    const int in = ::open(native(from).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return errno;
+    struct stat st;
+    if (::fstat(in, &st) != 0) {
+        const int error = errno;
+        ::close(in);
+        return error;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        ::close(in);
+        return EISDIR;
+    }
+    const int out = ::open(native(to).constData(),
+                           O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                           st.st_mode & 07777);
+    if (out < 0) {
+        const int error = errno;
+        ::close(in);
+        return error;
+    }
+
+    int error = 0;
+    std::vector<char> buffer(copyBufferSize);
+    while (error == 0) {
+        const ssize_t n = ::read(in, buffer.data(), buffer.size());
+        if (n == 0)
+            break;
+        if (n < 0) {
+            if (errno != EINTR)
+                error = errno;
+            continue;
+        }
+        for (ssize_t done = 0; done < n && error == 0;) {
+            const ssize_t w = ::write(out, buffer.data() + done, n - done);
+            if (w >= 0)
+                done += w;
+            else if (errno != EINTR)
+                error = errno;
+        }
+    }
+
+    if (error == 0) {
+        struct timespec times[2] = {};
+        times[0].tv_sec = st.st_atime;
+        times[1].tv_sec = st.st_mtime;
+        ::futimens(out, times);
+    }
+    // Delayed write errors (ENOSPC on NFS and the like) show up here
+    if (::close(out) != 0 && error == 0)
+        error = errno;
+    ::close(in);
+    if (error != 0)
+        ::unlink(native(to).constData());
+    return error;
+#else
+    const QFileInfo info(from);
+    if (info.isDir())
+        return EISDIR;
+    if (!QFile::copy(from, to))
+        return QFileInfo::exists(to) ? EEXIST : EIO;
+    QFile copied(to);
+    if (copied.open(QIODevice::ReadWrite))
+        copied.setFileTime(info.lastModified(),
+                           QFileDevice::FileModificationTime);
+    return 0;
+#endif
+}
+
+int PosixFileSystem::remove(const QString& path) {
+#ifndef Q_OS_WIN
+    return std::remove(native(path).constData()) == 0 ? 0 : errno;
+#else
+    const bool ok = QFileInfo(path).isDir() ? QDir().rmdir(path)
+                                            : QFile::remove(path);
+    return ok ? 0 : EACCES;
+#endif
+}
+
+int PosixFileSystem::moveTree(const QString& from, const QString& to) {
+    return TreeTransfer(QThread::idealThreadCount()).move(from, to).error;
+}
+
+int PosixFileSystem::removeTree(const QString& path) {
+    const QFileInfo info(path);
+    if (!info.exists() && !info.isSymLink())
+        return ENOENT;
+    // Never follows a link to a directory, only removes the link
+    if (!info.isDir() || info.isSymLink())
+        return this->remove(path);
+    return QDir(path).removeRecursively() ? 0 : EACCES;
+}
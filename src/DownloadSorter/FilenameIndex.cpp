@@ -0,0 +1,274 @@
+#include "../Include/DownloadSorter/FilenameIndex.h"
+#include "../Include/DownloadSorter/SettingsManager.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+constexpr quint32 snapshotMagic = 0x44534e31;  // "DSN1"
+
+// Packs three UTF-16 code units into one key
+template <typename Fn>
+void forEachTrigram(const QString& name, Fn fn) {
+    const char16_t* s = reinterpret_cast<const char16_t*>(name.utf16());
+    for (qsizetype i = 0; i + 2 < name.size(); ++i)
+        fn((quint64(s[i]) << 32) | (quint64(s[i + 1]) << 16) |
+           quint64(s[i + 2]));
+}
+
+QString lowerName(const QString& path) {
+    return path.mid(path.lastIndexOf('/') + 1).toLower();
+}
+
+void appendId(std::vector<quint32>& list, quint32 id) {
+    // Ids arrive in increasing order, so this also drops repeats of the
+    // same trigram within one name
+    if (list.empty() || list.back() != id)
+        list.push_back(id);
+}
+}  // namespace
+
+void FilenameIndex::build(const QStringList& input) {
+    this->paths = input;
+    this->lowerNames.assign(input.size(), QString());
+    this->ids.clear();
+    for (Postings& shard : this->shards)
+        shard.clear();
+
+    const qsizetype n = input.size();
+    const int threads = qBound(1, QThread::idealThreadCount(),
+                               int(qMax<qsizetype>(1, n / 4096)));
+    const qsizetype per = (n + threads - 1) / threads;
+
+    // Phase 1: each thread indexes one contiguous slice of ids into its own
+    // set of shards
+    std::vector<std::array<Postings, shardCount>> local(threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for (int t = 0; t < threads; ++t) {
+        pool.start([this, &input, &local, t, per, n]() {
+            const qsizetype begin = t * per;
+            const qsizetype end = qMin(n, begin + per);
+            for (qsizetype i = begin; i < end; ++i) {
+                const quint32 id = quint32(i);
+                this->lowerNames[i] = lowerName(input[i]);
+                forEachTrigram(this->lowerNames[i], [&](quint64 key) {
+                    appendId(local[t][key % shardCount][key], id);
+                });
+            }
+        });
+    }
+    pool.waitForDone();
+
+    // Phase 2: one task per shard concatenates the slices in thread order,
+    // which keeps every posting list sorted
+    for (int s = 0; s < shardCount; ++s) {
+        pool.start([this, &local, s, threads]() {
+            Postings& out = this->shards[s];
+            for (int t = 0; t < threads; ++t) {
+                for (auto it = local[t][s].begin(); it != local[t][s].end();
+                     ++it) {
+                    std::vector<quint32>& dst = out[it.key()];
+                    if (dst.empty())
+                        dst = std::move(it.value());
+                    else
+                        dst.insert(dst.end(), it.value().begin(),
+                                   it.value().end());
+                }
+            }
+        });
+    }
+    pool.waitForDone();
+
+    this->ids.reserve(n);
+    for (qsizetype i = 0; i < n; ++i)
+        this->ids.insert(input[i], quint32(i));
+}
+
+void FilenameIndex::add(const QString& path) {
+    if (this->ids.contains(path))
+        return;
+
+    const quint32 id = quint32(this->paths.size());
+    this->paths.append(path);
+    this->lowerNames.push_back(lowerName(path));
+    this->ids.insert(path, id);
+    forEachTrigram(this->lowerNames.back(), [&](quint64 key) {
+        appendId(this->shards[key % shardCount][key], id);
+    });
+}
+
+void FilenameIndex::remove(const QString& path) {
+    const auto it = this->ids.find(path);
+    if (it == this->ids.end())
+        return;
+
+    // Postings keep the stale id; an empty name never matches a query
+    this->paths[it.value()].clear();
+    this->lowerNames[it.value()].clear();
+    this->ids.erase(it);
+}
+
+QStringList FilenameIndex::search(const QString& query, int limit) const {
+    QStringList results;
+    const QString q = query.trimmed().toLower();
+    if (q.isEmpty())
+        return results;
+
+    // Too short to have a trigram: plain scan
+    if (q.size() < 3) {
+        for (size_t id = 0;
+             id < this->lowerNames.size() && results.size() < limit; ++id) {
+            if (this->lowerNames[id].contains(q))
+                results.append(this->paths[id]);
+        }
+        return results;
+    }
+
+    std::vector<const std::vector<quint32>*> lists;
+    bool missing = false;
+    forEachTrigram(q, [&](quint64 key) {
+        const Postings& shard = this->shards[key % shardCount];
+        const auto it = shard.constFind(key);
+        if (it == shard.constEnd())
+            missing = true;
+        else
+            lists.push_back(&it.value());
+    });
+    if (missing)
+        return results;
+
+    // Intersect starting from the rarest trigram
+    std::sort(lists.begin(), lists.end(),
+              [](const auto* a, const auto* b) {
+                  return a->size() < b->size();
+              });
+    std::vector<quint32> candidates = *lists.front();
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+        std::vector<quint32> next;
+        std::set_intersection(candidates.begin(), candidates.end(),
+                              lists[i]->begin(), lists[i]->end(),
+                              std::back_inserter(next));
+        candidates.swap(next);
+    }
+
+    // Trigrams can match out of order; confirm the real substring
+    for (quint32 id : candidates) {
+        if (this->lowerNames[id].contains(q)) {
+            results.append(this->paths[id]);
+            if (results.size() >= limit)
+                break;
+        }
+    }
+    return results;
+}
+
+QStringList FilenameIndex::allPaths() const {
+    QStringList list;
+    list.reserve(this->ids.size());
+    for (const QString& path : this->paths) {
+        if (!path.isEmpty())
+            list.append(path);
+    }
+    return list;
+}
+
+QString FilenameIndex::snapshotPath(const QString& root) {
+    return SettingsManager::dataPath(
+        QStringLiteral("names-%1.bin").arg(SettingsManager::rootKey(root)));
+}
+
+bool FilenameIndex::snapshotIsFresh(const QString& root,
+                                    const QStringList& categoryFolders) {
+    const QFileInfo info(snapshotPath(root));
+    if (!info.exists())
+        return false;
+    // Anything added or removed at the top of a category folder by hand
+    // moves its modification time past the snapshot's
+    const QDateTime taken = info.lastModified();
+    return std::none_of(categoryFolders.begin(), categoryFolders.end(),
+                        [&taken](const QString& folder) {
+                            const QFileInfo dir(folder);
+                            return dir.exists() && dir.lastModified() > taken;
+                        });
+}
+
+void FilenameIndex::invalidateSnapshot(const QString& root) {
+    QFile::remove(snapshotPath(root));
+}
+
+QStringList FilenameIndex::loadSnapshot(const QString& root) {
+    QStringList list;
+    QFile f(snapshotPath(root));
+    if (!f.open(QIODevice::ReadOnly))
+        return list;
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    in >> magic;
+    if (magic != snapshotMagic)
+        return list;
+    in >> list;
+    if (in.status() != QDataStream::Ok)
+        list.clear();
+    return list;
+}
+
+bool FilenameIndex::saveSnapshot(const QString& root,
+                                 const QStringList& paths) {
+    QSaveFile f(snapshotPath(root));
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << snapshotMagic << paths;
+    return out.status() == QDataStream::Ok && f.commit();
+}
+
+QStringList FilenameIndex::scan(const QStringList& categoryFolders) {
+    QMutex mutex;
+    QStringList all;
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+
+    // Top-level listings are cheap; every sub-directory is walked as its own
+    // task
+    for (const QString& folder : categoryFolders) {
+        QStringList top;
+        for (const QFileInfo& info : QDir(folder).entryInfoList(
+                 QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot)) {
+            const QString path = info.absoluteFilePath();
+            top.append(path);
+            if (!info.isDir() || info.isSymLink())
+                continue;
+
+            pool.start([&mutex, &all, path]() {
+                QStringList found;
+                QDirIterator it(path,
+                                QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot,
+                                QDirIterator::Subdirectories);
+                while (it.hasNext())
+                    found.append(it.next());
+                QMutexLocker lock(&mutex);
+                all.append(found);
+            });
+        }
+        QMutexLocker lock(&mutex);
+        all.append(top);
+    }
+    pool.waitForDone();
+    return all;
+}
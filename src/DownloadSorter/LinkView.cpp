@@ -0,0 +1,171 @@
+#include "../Include/DownloadSorter/LinkView.h"
+
+#include "../Include/DownloadSorter/SettingsManager.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+
+#include <filesystem>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+fs::path toPath(const QString& path) {
+    return fs::path(path.toStdU16String());
+}
+}  // namespace
+
+LinkView::LinkView(const QString& viewRoot, const QString& sourceRoot)
+    : root(viewRoot),
+      manifestPath(this->root.filePath(
+          QStringLiteral(".links-%1")
+              .arg(SettingsManager::rootKey(sourceRoot)))) {}
+
+QSet<QString> LinkView::loadManifest() const {
+    QSet<QString> created;
+    QFile f(this->manifestPath);
+    if (!f.open(QIODevice::ReadOnly))
+        return created;
+    while (!f.atEnd()) {
+        QByteArray line = f.readLine();
+        if (line.endsWith('\n'))
+            line.chop(1);
+        if (!line.isEmpty())
+            created.insert(QString::fromUtf8(line));
+    }
+    return created;
+}
+
+bool LinkView::saveManifest(const QSet<QString>& created) const {
+    QSaveFile f(this->manifestPath);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    for (const QString& rel : created)
+        f.write(rel.toUtf8() + '\n');
+    return f.commit();
+}
+
+QString LinkView::defaultRoot(const QString& downloadRoot) {
+    return QDir::cleanPath(downloadRoot) + " View";
+}
+
+// A symlink must point at the source; a hardlink must still share its inode
+// (a re-downloaded file gets a new one)
+bool LinkView::isCurrent(const QString& viewPath, const QString& source) {
+    const QFileInfo info(viewPath);
+    if (info.isSymLink())
+        return QDir::cleanPath(info.symLinkTarget()) ==
+               QDir::cleanPath(QFileInfo(source).absoluteFilePath());
+    if (!info.isFile())
+        return false;
+    std::error_code ec;
+    return fs::equivalent(toPath(viewPath), toPath(source), ec) && !ec;
+}
+
+bool LinkView::link(const QString& source,
+                    const QString& viewPath,
+                    Result& result) {
+    std::error_code ec;
+    const bool isDir = QFileInfo(source).isDir();
+    if (!isDir) {
+        // Fails across devices (and on filesystems without hardlinks)
+        fs::create_hard_link(toPath(source), toPath(viewPath), ec);
+        if (!ec) {
+            result.hardlinked++;
+            return true;
+        }
+        ec.clear();
+    }
+
+    if (isDir)
+        fs::create_directory_symlink(toPath(source), toPath(viewPath), ec);
+    else
+        fs::create_symlink(toPath(source), toPath(viewPath), ec);
+    if (ec) {
+        qWarning() << "Failed to link" << viewPath << "to" << source << ":"
+                   << QString::fromStdString(ec.message());
+        result.failed++;
+        return false;
+    }
+    result.symlinked++;
+    return true;
+}
+
+LinkView::Result LinkView::sync(const QMap<QString, QString>& links) {
+    Result result;
+    QMap<QString, QString> missing = links;
+    const QSet<QString> recorded = this->loadManifest();
+    QSet<QString> created;
+
+    // Walk what is already there: keep current links, drop stale ones this
+    // download folder's syncs created
+    const QDir::Filters filter = QDir::AllEntries | QDir::System |
+                                 QDir::Hidden | QDir::NoDotAndDotDot;
+    for (const QFileInfo& category :
+         this->root.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (category.isSymLink())
+            continue;
+        const QDir categoryDir(category.absoluteFilePath());
+        for (const QFileInfo& entry : categoryDir.entryInfoList(filter)) {
+            const QString path = entry.absoluteFilePath();
+            if (!entry.isSymLink() && !entry.isFile())
+                continue;
+            const QString rel = this->root.relativeFilePath(path);
+
+            const auto wanted = missing.constFind(path);
+            if (wanted != missing.constEnd() &&
+                isCurrent(path, wanted.value())) {
+                result.unchanged++;
+                created.insert(rel);
+                missing.erase(wanted);
+                continue;
+            }
+
+            // Only links the view made, and of a hardlink only while its
+            // file has another name: the last one is the only copy left
+            std::error_code ec;
+            const bool ours =
+                recorded.contains(rel) &&
+                (entry.isSymLink() ||
+                 fs::hard_link_count(toPath(path), ec) > 1);
+            if (!ours) {
+                result.kept++;
+                if (wanted != missing.constEnd()) {
+                    qWarning() << "Not linking" << wanted.value()
+                               << "into the view:" << path
+                               << "is in the way";
+                    result.failed++;
+                    missing.erase(wanted);
+                }
+                continue;
+            }
+
+            // Removes the link itself, never what it points at
+            fs::remove(toPath(path), ec);
+            if (ec) {
+                created.insert(rel);
+                result.failed++;
+                if (wanted != missing.constEnd())
+                    missing.erase(wanted);
+                continue;
+            }
+            if (wanted == missing.constEnd())
+                result.removed++;
+        }
+        // Categories nothing maps to any more
+        this->root.rmdir(category.fileName());
+    }
+
+    for (auto it = missing.constBegin(); it != missing.constEnd(); ++it) {
+        QDir().mkpath(QFileInfo(it.key()).path());
+        if (link(it.value(), it.key(), result))
+            created.insert(this->root.relativeFilePath(it.key()));
+    }
+    if (created != recorded && !this->saveManifest(created))
+        qWarning() << "Could not save the view manifest"
+                   << this->manifestPath;
+    return result;
+}
@@ -0,0 +1,300 @@
+#include "../Include/DownloadSorter/MemoryFileSystem.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QThread>
+
+#include <cerrno>
+
+MemoryFileSystem::MemoryFileSystem() {
+    this->nodes.insert(QStringLiteral("/"), {true, 0, QDateTime()});
+    this->mounts.insert(QStringLiteral("/"), Mount());
+}
+
+QString MemoryFileSystem::parentOf(const QString& path) {
+    const qsizetype slash = path.lastIndexOf('/');
+    if (slash < 0 || path == QLatin1String("/"))
+        return QString();
+    return slash == 0 ? QStringLiteral("/") : path.left(slash);
+}
+
+QString MemoryFileSystem::nameOf(const QString& path) {
+    return path.mid(path.lastIndexOf('/') + 1);
+}
+
+bool MemoryFileSystem::isBelow(const QString& path, const QString& prefix) {
+    if (prefix == QLatin1String("/") || path == prefix)
+        return true;
+    return path.size() > prefix.size() && path.startsWith(prefix) &&
+           path.at(prefix.size()) == '/';
+}
+
+QString MemoryFileSystem::mountOf(const QString& path) const {
+    QString best = QStringLiteral("/");
+    for (auto it = this->mounts.begin(); it != this->mounts.end(); ++it) {
+        if (it.key().size() > best.size() && isBelow(path, it.key()))
+            best = it.key();
+    }
+    return best;
+}
+
+void MemoryFileSystem::insertNode(const QString& path, Node node) {
+    node.inode = this->nextInode++;
+    this->nodes.insert(path, node);
+    const QString parent = parentOf(path);
+    if (!parent.isNull())
+        this->children[parent].insert(nameOf(path));
+    if (node.isDir)
+        this->children[path];
+    else
+        this->mounts[this->mountOf(path)].used += node.size;
+}
+
+void MemoryFileSystem::eraseNode(const QString& path) {
+    const Node node = this->nodes.take(path);
+    if (!node.isDir)
+        this->mounts[this->mountOf(path)].used -= node.size;
+    this->children[parentOf(path)].remove(nameOf(path));
+    this->children.remove(path);
+}
+
+int MemoryFileSystem::makePath(const QString& path) {
+    const auto it = this->nodes.constFind(path);
+    if (it != this->nodes.constEnd())
+        return it->isDir ? 0 : ENOTDIR;
+    const QString parent = parentOf(path);
+    if (!parent.isNull()) {
+        if (const int error = this->makePath(parent))
+            return error;
+    }
+    this->insertNode(path, {true, 0, QDateTime::currentDateTime()});
+    return 0;
+}
+
+int MemoryFileSystem::enter(Op op,
+                            const QString& path,
+                            const QString& other) const {
+    const int i = static_cast<int>(op);
+    int delay = 0;
+    {
+        QMutexLocker lock(&this->mutex);
+        ++this->calls[i];
+        delay = this->latency[i];
+    }
+    if (delay > 0)
+        QThread::usleep(delay);
+
+    QMutexLocker lock(&this->mutex);
+    for (auto it = this->faults.begin(); it != this->faults.end(); ++it) {
+        if (it->op != op ||
+            !(isBelow(path, it->prefix) ||
+              (!other.isNull() && isBelow(other, it->prefix))))
+            continue;
+        const int error = it->error;
+        if (it->remaining > 0 && --it->remaining == 0)
+            this->faults.erase(it);
+        return error;
+    }
+    return 0;
+}
+
+void MemoryFileSystem::addFile(const QString& path,
+                               qint64 size,
+                               const QDateTime& modified) {
+    const QString clean = QDir::cleanPath(path);
+    QMutexLocker lock(&this->mutex);
+    if (this->nodes.contains(clean) ||
+        this->makePath(parentOf(clean)) != 0)
+        return;
+    this->insertNode(clean, {false, size, modified});
+}
+
+void MemoryFileSystem::addDirectory(const QString& path) {
+    QMutexLocker lock(&this->mutex);
+    this->makePath(QDir::cleanPath(path));
+}
+
+void MemoryFileSystem::mount(const QString& mountPoint, qint64 capacity) {
+    QMutexLocker lock(&this->mutex);
+    const QString clean = QDir::cleanPath(mountPoint);
+    this->makePath(clean);
+    this->mounts[clean].capacity = capacity;
+
+    // Files already there now count against the new device
+    for (Mount& m : this->mounts)
+        m.used = 0;
+    for (auto it = this->nodes.begin(); it != this->nodes.end(); ++it) {
+        if (!it->isDir)
+            this->mounts[this->mountOf(it.key())].used += it->size;
+    }
+}
+
+void MemoryFileSystem::setLatency(Op op, int microseconds) {
+    QMutexLocker lock(&this->mutex);
+    this->latency[static_cast<int>(op)] = microseconds;
+}
+
+void MemoryFileSystem::injectError(Op op,
+                                   const QString& prefix,
+                                   int error,
+                                   int count) {
+    QMutexLocker lock(&this->mutex);
+    this->faults.append({op, QDir::cleanPath(prefix), error, count});
+}
+
+void MemoryFileSystem::clearErrors() {
+    QMutexLocker lock(&this->mutex);
+    this->faults.clear();
+}
+
+qint64 MemoryFileSystem::callCount(Op op) const {
+    QMutexLocker lock(&this->mutex);
+    return this->calls[static_cast<int>(op)];
+}
+
+QVector<FileSystem::Entry> MemoryFileSystem::list(const QString& dir) const {
+    const QString clean = QDir::cleanPath(dir);
+    QVector<Entry> entries;
+    if (this->enter(Op::List, clean) != 0)
+        return entries;
+
+    QMutexLocker lock(&this->mutex);
+    const auto names = this->children.constFind(clean);
+    if (names == this->children.constEnd())
+        return entries;
+    entries.reserve(names->size());
+    const QString base = clean == QLatin1String("/") ? QString() : clean;
+    for (const QString& name : *names) {
+        // Hidden like on the real disk
+        if (name.startsWith('.'))
+            continue;
+        entries.append({name, this->nodes.value(base + '/' + name).isDir});
+    }
+    return entries;
+}
+
+bool MemoryFileSystem::stat(const QString& path, Entry* entry) const {
+    const QString clean = QDir::cleanPath(path);
+    if (this->enter(Op::Stat, clean) != 0)
+        return false;
+
+    QMutexLocker lock(&this->mutex);
+    const auto it = this->nodes.constFind(clean);
+    if (it == this->nodes.constEnd())
+        return false;
+    if (entry)
+        *entry = {nameOf(clean), it->isDir, it->size, it->modified};
+    return true;
+}
+
+qint64 MemoryFileSystem::totalSize(const QString& path) const {
+    QMutexLocker lock(&this->mutex);
+    qint64 total = 0;
+    QStringList pending{QDir::cleanPath(path)};
+    while (!pending.isEmpty()) {
+        const QString current = pending.takeLast();
+        const Node node = this->nodes.value(current);
+        if (!node.isDir) {
+            total += node.size;
+            continue;
+        }
+        const QString base =
+            current == QLatin1String("/") ? QString() : current;
+        for (const QString& name : this->children.value(current))
+            pending.append(base + '/' + name);
+    }
+    return total;
+}
+
+QByteArray MemoryFileSystem::device(const QString& path) const {
+    QMutexLocker lock(&this->mutex);
+    return this->mountOf(QDir::cleanPath(path)).toUtf8();
+}
+
+quint64 MemoryFileSystem::physicalOffset(const QString& path) const {
+    QMutexLocker lock(&this->mutex);
+    return this->nodes.value(QDir::cleanPath(path)).inode;
+}
+
+int MemoryFileSystem::mkpath(const QString& path) {
+    const QString clean = QDir::cleanPath(path);
+    if (const int error = this->enter(Op::Mkpath, clean))
+        return error;
+    QMutexLocker lock(&this->mutex);
+    return this->makePath(clean);
+}
+
+int MemoryFileSystem::rename(const QString& from, const QString& to) {
+    const QString src = QDir::cleanPath(from);
+    const QString dst = QDir::cleanPath(to);
+    if (const int error = this->enter(Op::Rename, src, dst))
+        return error;
+
+    QMutexLocker lock(&this->mutex);
+    if (!this->nodes.contains(src))
+        return ENOENT;
+    if (this->nodes.contains(dst))
+        return EEXIST;
+    if (!this->nodes.value(parentOf(dst)).isDir)
+        return ENOENT;
+    if (this->mountOf(src) != this->mountOf(dst))
+        return EXDEV;
+    if (isBelow(dst, src))
+        return EINVAL;
+
+    // Re-key the whole subtree, parents before children
+    QStringList subtree{src};
+    for (qsizetype i = 0; i < subtree.size(); ++i) {
+        const QString current = subtree[i];
+        for (const QString& name : this->children.value(current))
+            subtree.append(current + '/' + name);
+    }
+    for (const QString& path : subtree) {
+        const QString moved = dst + path.mid(src.size());
+        this->nodes.insert(moved, this->nodes.take(path));
+        if (this->children.contains(path))
+            this->children.insert(moved, this->children.take(path));
+    }
+    this->children[parentOf(src)].remove(nameOf(src));
+    this->children[parentOf(dst)].insert(nameOf(dst));
+    return 0;
+}
+
+int MemoryFileSystem::copy(const QString& from, const QString& to) {
+    const QString src = QDir::cleanPath(from);
+    const QString dst = QDir::cleanPath(to);
+    if (const int error = this->enter(Op::Copy, src, dst))
+        return error;
+
+    QMutexLocker lock(&this->mutex);
+    const auto it = this->nodes.constFind(src);
+    if (it == this->nodes.constEnd())
+        return ENOENT;
+    const Node node = *it;
+    if (node.isDir)
+        return EISDIR;
+    if (this->nodes.contains(dst))
+        return EEXIST;
+    if (!this->nodes.contains(parentOf(dst)))
+        return ENOENT;
+    const Mount& target = this->mounts[this->mountOf(dst)];
+    if (target.capacity >= 0 && target.used + node.size > target.capacity)
+        return ENOSPC;
+    this->insertNode(dst, node);
+    return 0;
+}
+
+int MemoryFileSystem::remove(const QString& path) {
+    const QString clean = QDir::cleanPath(path);
+    if (const int error = this->enter(Op::Remove, clean))
+        return error;
+
+    QMutexLocker lock(&this->mutex);
+    if (clean == QLatin1String("/"))
+        return EBUSY;
+    if (!this->nodes.contains(clean))
+        return ENOENT;
+    if (!this->children.value(clean).isEmpty())
+        return ENOTEMPTY;
+    this->eraseNode(clean);
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include "../Include/DownloadSorter/Resharder.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <functional>
+
+namespace {
+// Renames per pool task
+constexpr qsizetype batchSize = 256;
+
+// Same shard for a name on every run and every machine
+quint32 nameHash(const QString& name) {
+    // FNV-1a
+    const QByteArray utf8 = name.toUtf8();
+    quint32 hash = 2166136261u;
+    for (const char c : utf8) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool allDigits(const QString& text, int base) {
+    for (const QChar c : text) {
+        const bool digit = c >= '0' && c <= '9';
+        const bool hex = base == 16 && c >= 'a' && c <= 'f';
+        if (!digit && !hex)
+            return false;
+    }
+    return !text.isEmpty();
+}
+}  // namespace
+
+// -- ShardLayout
+
+ShardLayout ShardLayout::parse(const QString& text, bool* ok) {
+    const QString spec = text.trimmed().toLower();
+    ShardLayout layout;
+    bool valid = true;
+    if (spec == QLatin1String("year/month")) {
+        layout.kind = Kind::YearMonth;
+    } else if (spec.startsWith(QLatin1String("hash:"))) {
+        const int fanOut = spec.mid(5).toInt();
+        const int digits = fanOut == 16     ? 1
+                           : fanOut == 256  ? 2
+                           : fanOut == 4096 ? 3
+                                            : 0;
+        valid = digits > 0;
+        if (valid) {
+            layout.kind = Kind::Hash;
+            layout.hashDigits = digits;
+        }
+    } else {
+        valid = spec.isEmpty() || spec == QLatin1String("flat");
+    }
+    if (ok)
+        *ok = valid;
+    return layout;
+}
+
+QString ShardLayout::toString() const {
+    switch (this->kind) {
+        case Kind::YearMonth:
+            return QStringLiteral("year/month");
+        case Kind::Hash:
+            return QStringLiteral("hash:%1").arg(1 << (4 * this->hashDigits));
+        default:
+            return QString();
+    }
+}
+
+int ShardLayout::depth() const {
+    switch (this->kind) {
+        case Kind::YearMonth:
+            return 2;
+        case Kind::Hash:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+bool ShardLayout::isShardName(const QString& name, int level) const {
+    switch (this->kind) {
+        case Kind::YearMonth:
+            if (level == 0)
+                return name.size() == 4 && allDigits(name, 10);
+            return level == 1 && name.size() == 2 && allDigits(name, 10) &&
+                   name.toInt() >= 1 && name.toInt() <= 12;
+        case Kind::Hash:
+            return level == 0 && name.size() == this->hashDigits &&
+                   allDigits(name, 16);
+        default:
+            return false;
+    }
+}
+
+QString ShardLayout::subfolder(const QString& name,
+                               const QDateTime& modified) const {
+    switch (this->kind) {
+        case Kind::YearMonth:
+            return (modified.isValid() ? modified
+                                       : QDateTime::currentDateTime())
+                .toString(QStringLiteral("yyyy/MM"));
+        case Kind::Hash: {
+            const quint32 mask = (1u << (4 * this->hashDigits)) - 1;
+            return QString::number(nameHash(name) & mask, 16)
+                .rightJustified(this->hashDigits, '0');
+        }
+        default:
+            return QString();
+    }
+}
+
+// -- Resharder
+
+Resharder::Resharder(std::shared_ptr<FileSystem> fileSystem)
+    : fs(std::move(fileSystem)) {}
+
+Resharder::Result Resharder::reshard(const QString& folder,
+                                     const ShardLayout& from,
+                                     const ShardLayout& to,
+                                     int maxThreads) const {
+    Result result;
+    if (from == to)
+        return result;
+
+    struct Item {
+        QString path;
+        QString name;
+        bool isDir;
+    };
+
+    QMutex mutex;
+    QVector<Item> items;
+    QStringList oldShards;
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, maxThreads));
+
+    // Every old shard folder is listed as its own task. Entries that only
+    // look like a shard of the new layout at the top are taken to be one
+    // (sorts since the layout changed already use them) and left alone.
+    std::function<void(const QString&, int)> walk = [&](const QString& dir,
+                                                        int level) {
+        QVector<Item> found;
+        for (const FileSystem::Entry& entry : this->fs->list(dir)) {
+            const QString path = dir + "/" + entry.name;
+            if (entry.isDir && level < from.depth() &&
+                from.isShardName(entry.name, level)) {
+                QMutexLocker lock(&mutex);
+                oldShards.append(path);
+                pool.start([&walk, path, level]() { walk(path, level + 1); });
+                continue;
+            }
+            if (entry.isDir && level == 0 && to.isShardName(entry.name, 0))
+                continue;
+            found.append({path, entry.name, entry.isDir});
+        }
+        QMutexLocker lock(&mutex);
+        items.append(found);
+    };
+    walk(QDir::cleanPath(folder), 0);
+    pool.waitForDone();
+
+    std::atomic<int> moved{0};
+    std::atomic<int> unchanged{0};
+    std::atomic<int> failed{0};
+    for (qsizetype start = 0; start < items.size(); start += batchSize) {
+        pool.start([&, start]() {
+            QSet<QString> created;
+            const qsizetype end = qMin(start + batchSize, items.size());
+            for (qsizetype i = start; i < end; ++i) {
+                const Item& item = items[i];
+                QDateTime modified;
+                if (to.kind == ShardLayout::Kind::YearMonth) {
+                    FileSystem::Entry info;
+                    if (this->fs->stat(item.path, &info))
+                        modified = info.modified;
+                }
+                const QString dir = QDir::cleanPath(
+                    folder + "/" + to.subfolder(item.name, modified));
+                if (item.path == dir + "/" + item.name) {
+                    unchanged++;
+                    continue;
+                }
+
+                int error = 0;
+                if (!created.contains(dir)) {
+                    error = this->fs->mkpath(dir);
+                    if (error == 0)
+                        created.insert(dir);
+                }
+                // Another worker may claim the same free name first
+                for (int tries = 0; error == 0 || error == EEXIST; ++tries) {
+                    if (error == EEXIST && tries >= 100)
+                        break;
+                    error = this->fs->rename(
+                        item.path,
+                        this->fs->freePath(dir, item.name, item.isDir));
+                    if (error == 0)
+                        break;
+                }
+
+                if (error != 0) {
+                    qWarning() << "Failed to reshard" << item.path << ":"
+                               << qt_error_string(error);
+                    failed++;
+                } else {
+                    moved++;
+                }
+            }
+        });
+    }
+    pool.waitForDone();
+
+    // Deepest first so a year goes once its months are gone; folders with
+    // anything left in them simply stay
+    std::sort(oldShards.begin(), oldShards.end(),
+              [](const QString& a, const QString& b) {
+                  return a.size() > b.size();
+              });
+    for (const QString& dir : oldShards)
+        this->fs->remove(dir);
+
+    result.moved = moved;
+    result.unchanged = unchanged;
+    result.failed = failed;
+    return result;
+}
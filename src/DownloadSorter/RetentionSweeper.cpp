@@ -0,0 +1,279 @@
+#include "../Include/DownloadSorter/RetentionSweeper.h"
+#include "../Include/DownloadSorter/ColdStorage.h"
+#include "../Include/DownloadSorter/StorageStats.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+// Files in one directory are unlinked in groups of this many per task, so a
+// folder with millions of entries spreads over every worker
+constexpr qsizetype unlinkBatchSize = 1024;
+
+#ifndef Q_OS_WIN
+int openDir(int parentFd, const char* name) {
+    return ::openat(parentFd, name,
+                    O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+}
+
+// Depth-first removal relative to open directory handles, so no path is
+// resolved more than once however deep the tree goes
+bool removeTree(int parentFd, const QByteArray& name) {
+    const int fd = openDir(parentFd, name.constData());
+    if (fd < 0)
+        return false;
+    DIR* dir = ::fdopendir(fd);
+    if (!dir) {
+        ::close(fd);
+        return false;
+    }
+
+    bool ok = true;
+    while (const dirent* entry = ::readdir(dir)) {
+        const QByteArray child(entry->d_name);
+        if (child == "." || child == "..")
+            continue;
+        if (::unlinkat(fd, entry->d_name, 0) == 0)
+            continue;
+        if (errno == EISDIR || errno == EPERM)
+            ok = removeTree(fd, child) && ok;
+        else
+            ok = false;
+    }
+    ::closedir(dir);
+    return ::unlinkat(parentFd, name.constData(), AT_REMOVEDIR) == 0 && ok;
+}
+#endif
+}  // namespace
+
+RetentionSweeper::RetentionSweeper(
+    const QString& root,
+    const QMap<QString, RetentionRule>& rules,
+    const QMap<QString, QString>& destinationRoots,
+    const QMap<QString, ShardLayout>& shardLayouts)
+    : root(root),
+      rules(rules),
+      destinationRoots(destinationRoots),
+      shardLayouts(shardLayouts) {}
+
+QList<RetentionSweeper::Item> RetentionSweeper::selectVictims(
+    QList<Item> items,
+    const RetentionRule& rule) {
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return a.modified > b.modified;
+    });
+
+    const QDateTime cutoff =
+        rule.maxAgeDays > 0
+            ? QDateTime::currentDateTime().addDays(-rule.maxAgeDays)
+            : QDateTime();
+    const qint64 budget = rule.maxTotalMB * 1024 * 1024;
+    qint64 kept = 0;
+    bool overBudget = false;
+
+    QList<Item> victims;
+    for (qsizetype i = 0; i < items.size(); ++i) {
+        const Item& item = items[i];
+        // Once the newer items fill the budget everything older goes too
+        overBudget = overBudget || (budget > 0 && kept + item.size > budget);
+        const bool drop = overBudget ||
+                          (rule.keepNewest > 0 && i >= rule.keepNewest) ||
+                          (cutoff.isValid() && item.modified < cutoff);
+        if (drop)
+            victims.append(item);
+        else
+            kept += item.size;
+    }
+    return victims;
+}
+
+RetentionSweeper::Result RetentionSweeper::plan(int maxThreads) const {
+    struct Listing {
+        RetentionRule rule;
+        ShardLayout layout;
+        QString path;
+        QList<Item> items;
+    };
+
+    std::vector<Listing> listings;
+    for (auto it = this->rules.begin(); it != this->rules.end(); ++it) {
+        // A category is a folder name, never a path: "." or "/home/me"
+        // would sweep the root itself or anything on disk
+        const QString& name = it.key();
+        if (name.isEmpty() || name == QLatin1String(".") ||
+            name == QLatin1String("..") || name.contains('/') ||
+            name.contains('\\') || QDir::isAbsolutePath(name)) {
+            qWarning() << "Ignoring retention rule for" << name
+                       << ": not a category folder";
+            continue;
+        }
+        const QString base = this->destinationRoots.value(it.key());
+        const QDir rootDir(base.isEmpty() ? this->root : base);
+        if (it.value().isActive() && rootDir.exists(it.key()))
+            listings.push_back({it.value(), this->shardLayouts.value(it.key()),
+                                rootDir.absoluteFilePath(it.key()), {}});
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, maxThreads));
+
+    // One listing task per category folder; shard folders are walked
+    // through, their contents being the items
+    for (Listing& listing : listings) {
+        pool.start([&listing]() {
+            QList<QPair<QString, int>> dirs = {{listing.path, 0}};
+            while (!dirs.isEmpty()) {
+                const auto [path, level] = dirs.takeLast();
+                QDirIterator it(path, QDir::Files | QDir::Dirs |
+                                          QDir::NoDotAndDotDot);
+                while (it.hasNext()) {
+                    it.next();
+                    const QFileInfo info = it.fileInfo();
+                    if (info.fileName() == ColdStorage::storeDirName)
+                        continue;
+                    Item item;
+                    item.path = info.absoluteFilePath();
+                    item.modified = info.lastModified();
+                    item.isDir = info.isDir() && !info.isSymLink();
+                    item.size = item.isDir ? 0 : info.size();
+                    if (item.isDir && level < listing.layout.depth() &&
+                        listing.layout.isShardName(info.fileName(), level)) {
+                        dirs.append({item.path, level + 1});
+                        continue;
+                    }
+                    listing.items.append(item);
+                }
+            }
+        });
+    }
+    pool.waitForDone();
+
+    // Directory sizes only matter for a size limit; each tree is its own task
+    for (Listing& listing : listings) {
+        if (listing.rule.maxTotalMB <= 0)
+            continue;
+        for (Item& item : listing.items) {
+            if (!item.isDir)
+                continue;
+            pool.start([&item]() {
+                item.size = StorageStats::entrySize(item.path);
+            });
+        }
+    }
+    pool.waitForDone();
+
+    Result result;
+    for (const Listing& listing : listings)
+        result.victims.append(selectVictims(listing.items, listing.rule));
+    std::sort(result.victims.begin(), result.victims.end(),
+              [](const Item& a, const Item& b) {
+                  return a.modified < b.modified;
+              });
+    return result;
+}
+
+RetentionSweeper::Result RetentionSweeper::sweep(int maxThreads) const {
+    return remove(this->plan(maxThreads).victims, maxThreads);
+}
+
+RetentionSweeper::Result RetentionSweeper::remove(const QList<Item>& victims,
+                                                  int maxThreads) {
+    Result result;
+    result.victims = victims;
+    std::atomic<int> removed{0};
+    std::atomic<int> failed{0};
+    std::atomic<qint64> freed{0};
+
+    auto finish = [&](const Item& item, bool ok) {
+        if (ok) {
+            removed++;
+            freed += item.size;
+        } else {
+            failed++;
+            qWarning() << "Retention could not remove" << item.path;
+        }
+    };
+
+    // Group plain files by directory, keeping the oldest-first order
+    QMap<QString, std::vector<qsizetype>> filesByDir;
+    std::vector<qsizetype> dirs;
+    for (qsizetype i = 0; i < victims.size(); ++i) {
+        if (victims[i].isDir)
+            dirs.push_back(i);
+        else
+            filesByDir[QFileInfo(victims[i].path).path()].push_back(i);
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, maxThreads));
+
+    for (auto it = filesByDir.begin(); it != filesByDir.end(); ++it) {
+        const std::vector<qsizetype>& all = it.value();
+        const qsizetype count = qsizetype(all.size());
+        for (qsizetype begin = 0; begin < count; begin += unlinkBatchSize) {
+            const qsizetype end = qMin(count, begin + unlinkBatchSize);
+            const std::vector<qsizetype> batch(all.begin() + begin,
+                                               all.begin() + end);
+            pool.start([&victims, &finish, dir = it.key(), batch]() {
+#ifndef Q_OS_WIN
+                // One directory handle for the whole batch
+                const int fd = ::open(QFile::encodeName(dir).constData(),
+                                      O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                for (qsizetype i : batch) {
+                    const QByteArray name = QFile::encodeName(
+                        QFileInfo(victims[i].path).fileName());
+                    finish(victims[i],
+                           fd >= 0 && ::unlinkat(fd, name.constData(), 0) == 0);
+                }
+                if (fd >= 0)
+                    ::close(fd);
+#else
+                Q_UNUSED(dir);
+                for (qsizetype i : batch)
+                    finish(victims[i], QFile::remove(victims[i].path));
+#endif
+            });
+        }
+    }
+
+    for (qsizetype i : dirs) {
+        pool.start([&victims, &finish, i]() {
+            const Item& item = victims[i];
+#ifndef Q_OS_WIN
+            const QFileInfo info(item.path);
+            const int parentFd =
+                ::open(QFile::encodeName(info.path()).constData(),
+                       O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            const bool ok =
+                parentFd >= 0 &&
+                removeTree(parentFd, QFile::encodeName(info.fileName()));
+            if (parentFd >= 0)
+                ::close(parentFd);
+            finish(item, ok);
+#else
+            finish(item, QDir(item.path).removeRecursively());
+#endif
+        });
+    }
+    pool.waitForDone();
+
+    result.removed = removed;
+    result.failed = failed;
+    result.bytesFreed = freed;
+    return result;
+}
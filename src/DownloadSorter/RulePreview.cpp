@@ -0,0 +1,111 @@
+#include "../Include/DownloadSorter/RulePreview.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+
+#include <utility>
+
+namespace {
+// Rows handed to the view per fetchMore()
+constexpr int fetchBatchSize = 256;
+// Entries classified between cancellation checks
+constexpr int cancelCheckInterval = 1024;
+
+struct CachedSnapshot {
+    QString root;
+    QDateTime modified;
+    std::shared_ptr<const RulePreview::Snapshot> entries;
+};
+
+QMutex cacheMutex;
+CachedSnapshot cache;
+}  // namespace
+
+std::shared_ptr<const RulePreview::Snapshot> RulePreview::snapshot(
+    const QString& root) {
+    const QString clean = QDir::cleanPath(root);
+    // Adding, removing or renaming an entry bumps the folder's own mtime
+    const QDateTime modified = QFileInfo(clean).lastModified();
+
+    QMutexLocker lock(&cacheMutex);
+    if (cache.entries && cache.root == clean && cache.modified == modified)
+        return cache.entries;
+    lock.unlock();
+
+    auto entries = std::make_shared<Snapshot>();
+    QDirIterator it(clean, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        entries->append({it.fileName(), it.fileInfo().isDir()});
+    }
+
+    lock.relock();
+    cache = {clean, modified, entries};
+    return entries;
+}
+
+bool RulePreview::evaluate(const Snapshot& entries,
+                           const RuleSet& rules,
+                           const std::atomic<int>& generation,
+                           int expected,
+                           QVector<RuleSet::Decision>* out) {
+    out->resize(entries.size());
+    for (qsizetype i = 0; i < entries.size(); ++i) {
+        if (i % cancelCheckInterval == 0 && generation != expected)
+            return false;
+        (*out)[i] = rules.classify(entries[i].name, entries[i].isDir);
+    }
+    return generation == expected;
+}
+
+void PreviewModel::setRows(QVector<Row> newRows) {
+    this->beginResetModel();
+    this->rows = std::move(newRows);
+    this->fetched = qMin(fetchBatchSize, int(this->rows.size()));
+    this->endResetModel();
+}
+
+int PreviewModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : this->fetched;
+}
+
+int PreviewModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 2;
+}
+
+bool PreviewModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && this->fetched < this->rows.size();
+}
+
+void PreviewModel::fetchMore(const QModelIndex& parent) {
+    if (parent.isValid())
+        return;
+    const int count =
+        qMin(fetchBatchSize, int(this->rows.size()) - this->fetched);
+    if (count <= 0)
+        return;
+    this->beginInsertRows(QModelIndex(), this->fetched,
+                          this->fetched + count - 1);
+    this->fetched += count;
+    this->endInsertRows();
+}
+
+QVariant PreviewModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= this->fetched ||
+        role != Qt::DisplayRole)
+        return QVariant();
+    const Row& row = this->rows[index.row()];
+    return index.column() == 0 ? row.entry : row.result;
+}
+
+QVariant PreviewModel::headerData(int section,
+                                  Qt::Orientation orientation,
+                                  int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
+        return section == 0 ? QStringLiteral("Entry")
+                            : QStringLiteral("Result");
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
@@ -0,0 +1,51 @@
+#include "../Include/DownloadSorter/RuleSet.h"
+
+RuleSet::RuleSet(const QMap<QString, QList<QString>>& mappings,
+                 const QList<QRegularExpression>& ignorePatterns)
+    : ignorePatterns(ignorePatterns) {
+    // The first folder (in key order) listing a suffix wins, as it always
+    // has with the linear search
+    for (auto it = mappings.begin(), end = mappings.end(); it != end; ++it) {
+        for (const QString& ext : it.value()) {
+            const QString key = ext.toLower();
+            if (!this->folderBySuffix.contains(key))
+                this->folderBySuffix.insert(key, it.key());
+        }
+    }
+}
+
+RuleSet::Decision RuleSet::classify(const QString& fileName,
+                                    bool isDir) const {
+    Decision decision;
+    if (builtinFolders.contains(fileName)) {
+        decision.outcome = Outcome::CategoryFolder;
+        return decision;
+    }
+
+    // Ignore via regex (both files and directories)
+    for (int i = 0; i < this->ignorePatterns.size(); ++i) {
+        const QRegularExpression& regex = this->ignorePatterns[i];
+        if (regex.isValid() && regex.match(fileName).hasMatch()) {
+            decision.outcome = Outcome::Ignored;
+            decision.ignoreIndex = i;
+            return decision;
+        }
+    }
+
+    if (isDir) {
+        decision.outcome = Outcome::Move;
+        decision.folder = foldersCategory;
+        return decision;
+    }
+
+    // Same as QFileInfo::suffix(): everything after the last dot
+    const qsizetype dot = fileName.lastIndexOf('.');
+    const QString suffix =
+        dot < 0 ? QString() : fileName.mid(dot + 1).toLower();
+    const auto it = this->folderBySuffix.constFind(suffix);
+    if (it != this->folderBySuffix.constEnd()) {
+        decision.outcome = Outcome::Move;
+        decision.folder = it.value();
+    }
+    return decision;
+}
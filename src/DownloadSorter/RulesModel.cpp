@@ -0,0 +1,402 @@
+#include "../Include/DownloadSorter/RulesModel.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QRegularExpression>
+#include <QtGui/QBrush>
+#include <QtGui/QColor>
+
+namespace {
+// Rows handed to the view per fetchMore()
+constexpr int fetchBatchSize = 256;
+}  // namespace
+
+RulesModel::RulesModel(QObject* parent) : QAbstractTableModel(parent) {
+    connect(this, &RulesModel::rulesEdited, this,
+            [this]() { ++this->editRevision; });
+}
+
+int RulesModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : this->fetched;
+}
+
+bool RulesModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && this->fetched < this->visible.size();
+}
+
+void RulesModel::fetchMore(const QModelIndex& parent) {
+    if (parent.isValid())
+        return;
+    const int count =
+        qMin(fetchBatchSize, int(this->visible.size()) - this->fetched);
+    if (count <= 0)
+        return;
+    this->beginInsertRows(QModelIndex(), this->fetched,
+                          this->fetched + count - 1);
+    this->fetched += count;
+    this->endInsertRows();
+}
+
+Qt::ItemFlags RulesModel::flags(const QModelIndex& index) const {
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+void RulesModel::setFilter(const QString& text) {
+    const QString trimmed = text.trimmed();
+    if (trimmed == this->filter)
+        return;
+    this->beginResetModel();
+    this->filter = trimmed;
+    this->resetRows();
+    this->endResetModel();
+}
+
+void RulesModel::setProblems(const QVector<QString>& found, int revision) {
+    // An edit that keeps the row count (retyping, reordering) would
+    // otherwise have markers land on the wrong rows
+    if (revision != this->editRevision ||
+        found.size() != this->sourceRowCount())
+        return;
+    this->problems = found;
+    if (this->fetched > 0)
+        emit dataChanged(this->index(0, 0),
+                         this->index(this->fetched - 1,
+                                     this->columnCount() - 1),
+                         {Qt::ForegroundRole, Qt::ToolTipRole});
+}
+
+int RulesModel::problemCount() const {
+    int count = 0;
+    for (const QString& problem : this->problems) {
+        if (!problem.isEmpty())
+            count++;
+    }
+    return count;
+}
+
+void RulesModel::removeViewRow(int row) {
+    if (row < 0 || row >= this->fetched)
+        return;
+    const int source = this->visible[row];
+
+    this->beginRemoveRows(QModelIndex(), row, row);
+    this->eraseSourceRow(source);
+    this->problems.removeAt(source);
+    this->visible.removeAt(row);
+    for (int& s : this->visible) {
+        if (s > source)
+            s--;
+    }
+    this->fetched--;
+    this->endRemoveRows();
+    emit rulesEdited();
+}
+
+int RulesModel::sourceRow(const QModelIndex& index) const {
+    if (!index.isValid() || index.row() >= this->fetched)
+        return -1;
+    return this->visible[index.row()];
+}
+
+QVariant RulesModel::problemData(int sourceRow, int role) const {
+    if (sourceRow < 0 || sourceRow >= this->problems.size() ||
+        this->problems[sourceRow].isEmpty())
+        return QVariant();
+    if (role == Qt::ForegroundRole)
+        return QBrush(QColor(255, 110, 110));
+    if (role == Qt::ToolTipRole)
+        return this->problems[sourceRow];
+    return QVariant();
+}
+
+void RulesModel::resetRows() {
+    const int count = this->sourceRowCount();
+    this->problems.resize(count);
+    this->visible.clear();
+    this->visible.reserve(count);
+    for (int row = 0; row < count; ++row) {
+        if (this->filter.isEmpty() || this->rowMatches(row, this->filter))
+            this->visible.append(row);
+    }
+    this->fetched = qMin(fetchBatchSize, int(this->visible.size()));
+}
+
+int RulesModel::showAppendedRow() {
+    const int source = this->sourceRowCount() - 1;
+    this->problems.resize(source + 1);
+    this->visible.append(source);
+
+    // A new row is shown even if it does not match the filter, and everything
+    // before it is fetched so the view can scroll to it
+    const int last = this->visible.size() - 1;
+    this->beginInsertRows(QModelIndex(), this->fetched, last);
+    this->fetched = last + 1;
+    this->endInsertRows();
+    emit rulesEdited();
+    return last;
+}
+
+// -- MappingsModel
+
+void MappingsModel::setMappings(const QMap<QString, QList<QString>>& mappings,
+                                const QMap<QString, QString>& roots,
+                                const QMap<QString, ShardLayout>& layouts) {
+    this->beginResetModel();
+    this->all.clear();
+    this->all.reserve(mappings.size());
+    for (auto it = mappings.begin(); it != mappings.end(); ++it)
+        this->all.append({it.key(), it.value(), roots.value(it.key()),
+                          layouts.value(it.key()).toString()});
+    this->problems.clear();
+    this->resetRows();
+    this->endResetModel();
+    emit rulesEdited();
+}
+
+QMap<QString, QList<QString>> MappingsModel::mappings() const {
+    QMap<QString, QList<QString>> map;
+    for (const Row& row : this->all) {
+        const QString folder = row.folder.trimmed();
+        if (!folder.isEmpty() && !row.extensions.isEmpty())
+            map[folder] = row.extensions;
+    }
+    return map;
+}
+
+QMap<QString, QString> MappingsModel::destinationRoots() const {
+    QMap<QString, QString> map;
+    for (const Row& row : this->all) {
+        const QString folder = row.folder.trimmed();
+        if (!folder.isEmpty() && !row.root.isEmpty())
+            map[folder] = row.root;
+    }
+    return map;
+}
+
+QMap<QString, ShardLayout> MappingsModel::shardLayouts() const {
+    QMap<QString, ShardLayout> map;
+    for (const Row& row : this->all) {
+        const QString folder = row.folder.trimmed();
+        const ShardLayout layout = ShardLayout::parse(row.sharding);
+        if (!folder.isEmpty() && !layout.isFlat())
+            map[folder] = layout;
+    }
+    return map;
+}
+
+int MappingsModel::addRow(const Row& row) {
+    this->all.append(row);
+    return this->showAppendedRow();
+}
+
+int MappingsModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 4;
+}
+
+QVariant MappingsModel::data(const QModelIndex& index, int role) const {
+    const int source = this->sourceRow(index);
+    if (source < 0)
+        return QVariant();
+
+    if (role == Qt::DisplayRole || role == Qt::EditRole) {
+        const Row& row = this->all[source];
+        switch (index.column()) {
+            case 0:
+                return row.folder;
+            case 1:
+                return row.extensions.join(", ");
+            case 2:
+                return row.root;
+            default:
+                return row.sharding;
+        }
+    }
+    return this->problemData(source, role);
+}
+
+bool MappingsModel::setData(const QModelIndex& index,
+                            const QVariant& value,
+                            int role) {
+    const int source = this->sourceRow(index);
+    if (source < 0 || role != Qt::EditRole)
+        return false;
+
+    Row& row = this->all[source];
+    if (index.column() == 0)
+        row.folder = value.toString().trimmed();
+    else if (index.column() == 1)
+        row.extensions = parseExtensions(value.toString());
+    else if (index.column() == 2)
+        row.root = QDir::fromNativeSeparators(value.toString().trimmed());
+    else
+        row.sharding = value.toString().trimmed().toLower();
+    emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
+    emit rulesEdited();
+    return true;
+}
+
+QVariant MappingsModel::headerData(int section,
+                                   Qt::Orientation orientation,
+                                   int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0:
+                return QStringLiteral("Folder");
+            case 1:
+                return QStringLiteral("Extensions");
+            case 2:
+                return QStringLiteral("Destination Root");
+            default:
+                return QStringLiteral("Sharding");
+        }
+    }
+    return RulesModel::headerData(section, orientation, role);
+}
+
+bool MappingsModel::rowMatches(int sourceRow, const QString& filter) const {
+    const Row& row = this->all[sourceRow];
+    if (row.folder.contains(filter, Qt::CaseInsensitive) ||
+        row.root.contains(filter, Qt::CaseInsensitive) ||
+        row.sharding.contains(filter, Qt::CaseInsensitive))
+        return true;
+    for (const QString& ext : row.extensions) {
+        if (ext.contains(filter, Qt::CaseInsensitive))
+            return true;
+    }
+    return false;
+}
+
+void MappingsModel::eraseSourceRow(int sourceRow) {
+    this->all.removeAt(sourceRow);
+}
+
+QStringList MappingsModel::parseExtensions(const QString& text) {
+    static const QRegularExpression separators(QStringLiteral("[,;\\s]+"));
+    QStringList exts;
+    for (QString ext : text.split(separators, Qt::SkipEmptyParts)) {
+        while (ext.startsWith('.'))
+            ext.remove(0, 1);
+        ext = ext.toLower();
+        if (!ext.isEmpty() && !exts.contains(ext))
+            exts.append(ext);
+    }
+    return exts;
+}
+
+QVector<QString> MappingsModel::validate(const QVector<Row>& rows) {
+    QVector<QString> problems(rows.size());
+    QHash<QString, int> folderRows;
+    QHash<QString, int> extensionRows;
+
+    for (int i = 0; i < rows.size(); ++i) {
+        const Row& row = rows[i];
+        QStringList found;
+        if (row.folder.isEmpty())
+            found.append(QStringLiteral("Folder name is empty."));
+        if (row.extensions.isEmpty())
+            found.append(QStringLiteral("No extensions."));
+        if (!row.root.isEmpty() && !QFileInfo(row.root).isDir())
+            found.append(QStringLiteral("Destination root does not exist."));
+        bool layoutOk = false;
+        ShardLayout::parse(row.sharding, &layoutOk);
+        if (!layoutOk)
+            found.append(QStringLiteral("Sharding must be empty, year/month, "
+                                        "hash:16, hash:256 or hash:4096."));
+
+        const auto folder = folderRows.constFind(row.folder);
+        if (!row.folder.isEmpty() && folder != folderRows.constEnd())
+            found.append(QStringLiteral("Folder is listed twice; only one "
+                                        "row is kept."));
+        else
+            folderRows.insert(row.folder, i);
+
+        for (const QString& ext : row.extensions) {
+            const auto other = extensionRows.constFind(ext);
+            if (other != extensionRows.constEnd() &&
+                rows[other.value()].folder != row.folder)
+                found.append(QStringLiteral("'%1' is also mapped to '%2'.")
+                                 .arg(ext, rows[other.value()].folder));
+            else
+                extensionRows.insert(ext, i);
+        }
+        problems[i] = found.join('\n');
+    }
+    return problems;
+}
+
+// -- IgnorePatternsModel
+
+void IgnorePatternsModel::setPatterns(const QList<QString>& patterns) {
+    this->beginResetModel();
+    this->all = patterns;
+    this->problems.clear();
+    this->resetRows();
+    this->endResetModel();
+    emit rulesEdited();
+}
+
+QList<QString> IgnorePatternsModel::patterns() const {
+    QList<QString> list;
+    for (const QString& pattern : this->all) {
+        if (!pattern.isEmpty())
+            list.append(pattern);
+    }
+    return list;
+}
+
+int IgnorePatternsModel::addRow(const QString& pattern) {
+    this->all.append(pattern);
+    return this->showAppendedRow();
+}
+
+int IgnorePatternsModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 1;
+}
+
+QVariant IgnorePatternsModel::data(const QModelIndex& index, int role) const {
+    const int source = this->sourceRow(index);
+    if (source < 0)
+        return QVariant();
+    if (role == Qt::DisplayRole || role == Qt::EditRole)
+        return this->all[source];
+    return this->problemData(source, role);
+}
+
+bool IgnorePatternsModel::setData(const QModelIndex& index,
+                                  const QVariant& value,
+                                  int role) {
+    const int source = this->sourceRow(index);
+    if (source < 0 || role != Qt::EditRole)
+        return false;
+    this->all[source] = value.toString();
+    emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
+    emit rulesEdited();
+    return true;
+}
+
+bool IgnorePatternsModel::rowMatches(int sourceRow,
+                                     const QString& filter) const {
+    return this->all[sourceRow].contains(filter, Qt::CaseInsensitive);
+}
+
+void IgnorePatternsModel::eraseSourceRow(int sourceRow) {
+    this->all.removeAt(sourceRow);
+}
+
+QVector<QString> IgnorePatternsModel::validate(const QStringList& patterns) {
+    QVector<QString> problems(patterns.size());
+    for (int i = 0; i < patterns.size(); ++i) {
+        const QString trimmed = patterns[i].trimmed();
+        if (trimmed.isEmpty())
+            continue;
+        const QRegularExpression re(trimmed);
+        if (!re.isValid())
+            problems[i] = QStringLiteral("Invalid regex at offset %1: %2")
+                              .arg(re.patternErrorOffset())
+                              .arg(re.errorString());
+    }
+    return problems;
+}
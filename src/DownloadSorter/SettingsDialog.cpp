@@ -1,15 +1,92 @@
 #include "../Include/DownloadSorter/SettingsDialog.h"
+#include <QCheckBox>
+#include <QComboBox>
 #include <QDialogButtonBox>
 #include <QGroupBox>
 #include <QHBoxLayout>
+#include <QHash>
+#include <QHeaderView>
 #include <QLabel>
-#include <QListWidget>
-#include <QListWidgetItem>
+#include <QLineEdit>
+#include <QListView>
 #include <QPushButton>
+#include <QSpinBox>
+#include <QStyledItemDelegate>
+#include <QTableView>
 #include <QTableWidget>
+#include <QTimer>
 #include <QVBoxLayout>
+#include "../Include/DownloadSorter/RulePreview.h"
+#include "../Include/DownloadSorter/RulesModel.h"
 #include "../Include/DownloadSorter/SettingsManager.h"
 
+#include <functional>
+
+namespace {
+// Reports every keystroke in a cell editor, before anything is committed
+class LiveEditDelegate : public QStyledItemDelegate {
+   public:
+    using Callback =
+        std::function<void(const QModelIndex& index, const QString& text)>;
+
+    LiveEditDelegate(Callback onEdited, QObject* parent)
+        : QStyledItemDelegate(parent), onEdited(std::move(onEdited)) {}
+
+    QWidget* createEditor(QWidget* parent,
+                          const QStyleOptionViewItem& option,
+                          const QModelIndex& index) const override {
+        QWidget* editor = QStyledItemDelegate::createEditor(parent, option,
+                                                            index);
+        if (auto* line = qobject_cast<QLineEdit*>(editor)) {
+            const QPersistentModelIndex persistent(index);
+            const Callback callback = this->onEdited;
+            QObject::connect(line, &QLineEdit::textEdited, line,
+                             [callback, persistent](const QString& text) {
+                                 callback(persistent, text);
+                             });
+        }
+        return editor;
+    }
+
+   private:
+    Callback onEdited;
+};
+
+// Edits a cell with a drop-down of the names `choices` returns at the time
+class ChoiceDelegate : public QStyledItemDelegate {
+   public:
+    using Choices = std::function<QStringList()>;
+
+    ChoiceDelegate(Choices choices, QObject* parent)
+        : QStyledItemDelegate(parent), choices(std::move(choices)) {}
+
+    QWidget* createEditor(QWidget* parent,
+                          const QStyleOptionViewItem&,
+                          const QModelIndex&) const override {
+        QComboBox* combo = new QComboBox(parent);
+        combo->addItems(this->choices());
+        return combo;
+    }
+
+    void setEditorData(QWidget* editor,
+                       const QModelIndex& index) const override {
+        QComboBox* combo = static_cast<QComboBox*>(editor);
+        combo->setCurrentIndex(
+            combo->findText(index.data(Qt::EditRole).toString()));
+    }
+
+    void setModelData(QWidget* editor,
+                      QAbstractItemModel* model,
+                      const QModelIndex& index) const override {
+        model->setData(index, static_cast<QComboBox*>(editor)->currentText(),
+                       Qt::EditRole);
+    }
+
+   private:
+    Choices choices;
+};
+}  // namespace
+
 SettingsDialog::SettingsDialog(QWidget* parent) : QDialog(parent) {
     setWindowTitle("Settings");
 
@@ -18,34 +95,145 @@ SettingsDialog::SettingsDialog(QWidget* parent) : QDialog(parent) {
     // Mappings section
     QGroupBox* mappingsGroup = new QGroupBox("File Type Mappings");
     QVBoxLayout* mappingsLayout = new QVBoxLayout(mappingsGroup);
-    mappingsTable = new QTableWidget();
-    mappingsTable->setColumnCount(2);
-    mappingsTable->setHorizontalHeaderLabels({"Folder", "Extensions"});
-    mappingsLayout->addWidget(mappingsTable);
+    ruleFilter = new QLineEdit();
+    ruleFilter->setPlaceholderText("Filter rules...");
+    ruleFilter->setClearButtonEnabled(true);
+    mappingsLayout->addWidget(ruleFilter);
+    mappingsModel = new MappingsModel(this);
+    mappingsView = new QTableView();
+    mappingsView->setModel(mappingsModel);
+    mappingsView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    mappingsView->setSelectionMode(QAbstractItemView::SingleSelection);
+    // Fixed row heights keep scrolling cheap on large rule sets
+    mappingsView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    mappingsView->verticalHeader()->hide();
+    mappingsView->horizontalHeader()->setStretchLastSection(true);
+    mappingsLayout->addWidget(mappingsView);
     QHBoxLayout* mappingsBtnLayout = new QHBoxLayout();
     addMappingBtn = new QPushButton("Add");
     removeMappingBtn = new QPushButton("Remove");
     mappingsBtnLayout->addWidget(addMappingBtn);
     mappingsBtnLayout->addWidget(removeMappingBtn);
     mappingsLayout->addLayout(mappingsBtnLayout);
-    layout->addWidget(mappingsGroup);
 
     // Ignore patterns section
     QGroupBox* ignoreGroup = new QGroupBox("Ignore Patterns (Regex)");
     QVBoxLayout* ignoreLayout = new QVBoxLayout(ignoreGroup);
-    ignoreList = new QListWidget();
+    ignoreModel = new IgnorePatternsModel(this);
+    ignoreView = new QListView();
+    ignoreView->setModel(ignoreModel);
+    ignoreView->setUniformItemSizes(true);
     // Allow common edit triggers (double-click, edit key, typing)
-    ignoreList->setEditTriggers(QAbstractItemView::DoubleClicked |
+    ignoreView->setEditTriggers(QAbstractItemView::DoubleClicked |
                                 QAbstractItemView::EditKeyPressed |
                                 QAbstractItemView::AnyKeyPressed);
-    ignoreLayout->addWidget(ignoreList);
+    ignoreLayout->addWidget(ignoreView);
     QHBoxLayout* ignoreBtnLayout = new QHBoxLayout();
     addIgnoreBtn = new QPushButton("Add");
     removeIgnoreBtn = new QPushButton("Remove");
     ignoreBtnLayout->addWidget(addIgnoreBtn);
     ignoreBtnLayout->addWidget(removeIgnoreBtn);
     ignoreLayout->addLayout(ignoreBtnLayout);
-    layout->addWidget(ignoreGroup);
+
+    // Preview section, shown next to the rule editors
+    QGroupBox* previewBox = new QGroupBox("Preview");
+    QVBoxLayout* previewLayout = new QVBoxLayout(previewBox);
+    previewSummary = new QLabel();
+    previewSummary->setWordWrap(true);
+    previewLayout->addWidget(previewSummary);
+    previewModel = new PreviewModel(this);
+    QTableView* previewView = new QTableView();
+    previewView->setModel(previewModel);
+    previewView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    previewView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    previewView->verticalHeader()->hide();
+    previewView->horizontalHeader()->setStretchLastSection(true);
+    previewLayout->addWidget(previewView);
+    previewGroup = previewBox;
+    previewGroup->hide();
+
+    QVBoxLayout* editorsLayout = new QVBoxLayout();
+    editorsLayout->addWidget(mappingsGroup);
+    editorsLayout->addWidget(ignoreGroup);
+    QHBoxLayout* rulesLayout = new QHBoxLayout();
+    rulesLayout->addLayout(editorsLayout, 1);
+    rulesLayout->addWidget(previewGroup, 1);
+    layout->addLayout(rulesLayout);
+
+    problemsLabel = new QLabel();
+    problemsLabel->setStyleSheet("color: rgb(255, 110, 110);");
+    problemsLabel->hide();
+    layout->addWidget(problemsLabel);
+
+    // Cold storage section
+    QGroupBox* coldGroup = new QGroupBox("Cold Storage");
+    QHBoxLayout* coldLayout = new QHBoxLayout(coldGroup);
+    coldLayout->addWidget(new QLabel("Compress files untouched for"));
+    coldStorageSpin = new QSpinBox();
+    coldStorageSpin->setRange(0, 3650);
+    coldStorageSpin->setSuffix(" days");
+    coldStorageSpin->setSpecialValueText("Never");
+    coldLayout->addWidget(coldStorageSpin);
+    coldLayout->addStretch(1);
+    layout->addWidget(coldGroup);
+
+    // Retention section
+    QGroupBox* retentionGroup = new QGroupBox("Retention (0 = no limit)");
+    QVBoxLayout* retentionLayout = new QVBoxLayout(retentionGroup);
+    retentionTable = new QTableWidget();
+    retentionTable->setColumnCount(4);
+    retentionTable->setHorizontalHeaderLabels(
+        {"Folder", "Max Age (days)", "Max Size (MB)", "Keep Newest"});
+    // Rules only apply to category folders, so only those can be picked
+    retentionTable->setItemDelegateForColumn(
+        0, new ChoiceDelegate(
+               [this]() {
+                   return QStringList(DownloadSorter::managedFolders(
+                       mappingsModel->mappings()));
+               },
+               this));
+    retentionLayout->addWidget(retentionTable);
+    QHBoxLayout* retentionBtnLayout = new QHBoxLayout();
+    addRetentionBtn = new QPushButton("Add");
+    removeRetentionBtn = new QPushButton("Remove");
+    retentionBtnLayout->addWidget(addRetentionBtn);
+    retentionBtnLayout->addWidget(removeRetentionBtn);
+    retentionLayout->addLayout(retentionBtnLayout);
+    layout->addWidget(retentionGroup);
+
+    // Output section
+    QGroupBox* outputGroup = new QGroupBox("Output");
+    QVBoxLayout* outputLayout = new QVBoxLayout(outputGroup);
+    viewModeCheck = new QCheckBox(
+        "Link files into a view folder instead of moving them");
+    outputLayout->addWidget(viewModeCheck);
+    viewFolderEdit = new QLineEdit();
+    viewFolderEdit->setPlaceholderText(
+        "View folder (default: \"<download folder> View\")");
+    viewFolderEdit->setEnabled(false);
+    outputLayout->addWidget(viewFolderEdit);
+    layoutOrderCheck = new QCheckBox(
+        "Copy to other drives in on-disk order (faster from spinning disks)");
+    outputLayout->addWidget(layoutOrderCheck);
+    extractArchivesCheck = new QCheckBox(
+        "Extract archives sorted into Downloaded Archives");
+    outputLayout->addWidget(extractArchivesCheck);
+    QHBoxLayout* duplicateLayout = new QHBoxLayout();
+    duplicateLayout->addWidget(
+        new QLabel("Folders identical to one already sorted:"));
+    duplicateFoldersCombo = new QComboBox();
+    // Item data is the DuplicateFolders value
+    duplicateFoldersCombo->addItem("Sort as \"name (n)\"",
+                                   int(DuplicateFolders::Rename));
+    duplicateFoldersCombo->addItem("Leave in place",
+                                   int(DuplicateFolders::Skip));
+    duplicateFoldersCombo->addItem("Delete", int(DuplicateFolders::Remove));
+    duplicateFoldersCombo->addItem("Sort as hardlinks to the sorted copy",
+                                   int(DuplicateFolders::Link));
+    duplicateLayout->addWidget(duplicateFoldersCombo);
+    duplicateLayout->addStretch(1);
+    outputLayout->addLayout(duplicateLayout);
+    layout->addWidget(outputGroup);
 
     // Buttons
     QDialogButtonBox* buttonBox =
@@ -60,56 +248,184 @@ SettingsDialog::SettingsDialog(QWidget* parent) : QDialog(parent) {
             &SettingsDialog::addIgnorePattern);
     connect(removeIgnoreBtn, &QPushButton::clicked, this,
             &SettingsDialog::removeIgnorePattern);
+    connect(addRetentionBtn, &QPushButton::clicked, this,
+            &SettingsDialog::addRetentionRule);
+    connect(removeRetentionBtn, &QPushButton::clicked, this,
+            &SettingsDialog::removeRetentionRule);
+    connect(viewModeCheck, &QCheckBox::toggled, viewFolderEdit,
+            &QLineEdit::setEnabled);
+    connect(ruleFilter, &QLineEdit::textChanged, this,
+            [this](const QString& text) {
+                mappingsModel->setFilter(text);
+                ignoreModel->setFilter(text);
+            });
+
+    validationTimer = new QTimer(this);
+    validationTimer->setSingleShot(true);
+    validationTimer->setInterval(150);
+    connect(validationTimer, &QTimer::timeout, this,
+            &SettingsDialog::validateRules);
+    // Any edit makes a running check stale and restarts the debounce
+    auto rulesEdited = [this]() {
+        ++validationGeneration;
+        validationTimer->start();
+    };
+    connect(mappingsModel, &RulesModel::rulesEdited, this, rulesEdited);
+    connect(ignoreModel, &RulesModel::rulesEdited, this, rulesEdited);
+
+    // Preview follows committed edits, keystrokes in open editors and the
+    // current row of either list
+    auto liveEdit = [this](const QModelIndex& index, const QString& text) {
+        editingIndex = index;
+        editingText = text;
+        updatePreview();
+    };
+    auto* mappingsDelegate = new LiveEditDelegate(liveEdit, this);
+    auto* ignoreDelegate = new LiveEditDelegate(liveEdit, this);
+    mappingsView->setItemDelegate(mappingsDelegate);
+    ignoreView->setItemDelegate(ignoreDelegate);
+    auto editorClosed = [this]() {
+        editingIndex = QPersistentModelIndex();
+        updatePreview();
+    };
+    connect(mappingsDelegate, &QAbstractItemDelegate::closeEditor, this,
+            editorClosed);
+    connect(ignoreDelegate, &QAbstractItemDelegate::closeEditor, this,
+            editorClosed);
+    connect(mappingsModel, &RulesModel::rulesEdited, this,
+            &SettingsDialog::updatePreview);
+    connect(ignoreModel, &RulesModel::rulesEdited, this,
+            &SettingsDialog::updatePreview);
+    connect(mappingsView->selectionModel(),
+            &QItemSelectionModel::currentChanged, this, [this]() {
+                previewIgnoreFocus = false;
+                updatePreview();
+            });
+    connect(ignoreView->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, [this]() {
+                previewIgnoreFocus = true;
+                updatePreview();
+            });
+
     connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
     connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
 }
 
-SettingsDialog::~SettingsDialog() {}
+SettingsDialog::~SettingsDialog() {
+    ++previewGeneration;
+    previewPool.waitForDone();
+    validationPool.waitForDone();
+}
 
-void SettingsDialog::setMappings(
-    const QMap<QString, QList<QString>>& mappings) {
-    mappingsTable->setRowCount(mappings.size());
-    int row = 0;
-    for (auto it = mappings.begin(); it != mappings.end(); ++it) {
-        mappingsTable->setItem(row, 0, new QTableWidgetItem(it.key()));
-        mappingsTable->setItem(row, 1,
-                               new QTableWidgetItem(it.value().join(", ")));
-        row++;
-    }
+void SettingsDialog::setMappings(const QMap<QString, QList<QString>>& mappings,
+                                 const QMap<QString, QString>& roots,
+                                 const QMap<QString, ShardLayout>& layouts) {
+    mappingsModel->setMappings(mappings, roots, layouts);
 }
 
 QMap<QString, QList<QString>> SettingsDialog::getMappings() const {
-    QMap<QString, QList<QString>> map;
-    for (int row = 0; row < mappingsTable->rowCount(); ++row) {
-        QString folder = mappingsTable->item(row, 0)->text();
-        QString extsStr = mappingsTable->item(row, 1)->text();
-        QList<QString> exts = extsStr.split(", ", Qt::SkipEmptyParts);
-        if (!folder.isEmpty() && !exts.isEmpty()) {
-            map[folder] = exts;
-        }
-    }
-    return map;
+    return mappingsModel->mappings();
+}
+
+QMap<QString, QString> SettingsDialog::getDestinationRoots() const {
+    return mappingsModel->destinationRoots();
+}
+
+QMap<QString, ShardLayout> SettingsDialog::getShardLayouts() const {
+    return mappingsModel->shardLayouts();
 }
 
 void SettingsDialog::setIgnorePatterns(const QList<QString>& patterns) {
-    ignoreList->clear();
-    for (const QString& pattern : patterns) {
-        // create editable items for existing patterns
-        QListWidgetItem* it = new QListWidgetItem(pattern);
-        it->setFlags(it->flags() | Qt::ItemIsEditable);
-        ignoreList->addItem(it);
-    }
+    ignoreModel->setPatterns(patterns);
 }
 
 QList<QString> SettingsDialog::getIgnorePatterns() const {
-    QList<QString> patterns;
-    for (int i = 0; i < ignoreList->count(); ++i) {
-        QString pattern = ignoreList->item(i)->text();
-        if (!pattern.isEmpty()) {
-            patterns.append(pattern);
+    return ignoreModel->patterns();
+}
+
+void SettingsDialog::setColdStorageAgeDays(int days) {
+    coldStorageSpin->setValue(days);
+}
+
+int SettingsDialog::getColdStorageAgeDays() const {
+    return coldStorageSpin->value();
+}
+
+// Numeric cells hold ints so the table edits them with a spin box
+static QTableWidgetItem* numberItem(qint64 value) {
+    QTableWidgetItem* item = new QTableWidgetItem();
+    item->setData(Qt::EditRole, value);
+    return item;
+}
+
+void SettingsDialog::setRetentionRules(
+    const QMap<QString, RetentionRule>& rules) {
+    retentionTable->setRowCount(rules.size());
+    int row = 0;
+    for (auto it = rules.begin(); it != rules.end(); ++it) {
+        retentionTable->setItem(row, 0, new QTableWidgetItem(it.key()));
+        retentionTable->setItem(row, 1, numberItem(it.value().maxAgeDays));
+        retentionTable->setItem(row, 2, numberItem(it.value().maxTotalMB));
+        retentionTable->setItem(row, 3, numberItem(it.value().keepNewest));
+        row++;
+    }
+}
+
+QMap<QString, RetentionRule> SettingsDialog::getRetentionRules() const {
+    // Rules of categories whose mapping was removed meanwhile are dropped
+    const QList<QString> folders =
+        DownloadSorter::managedFolders(mappingsModel->mappings());
+    QMap<QString, RetentionRule> rules;
+    for (int row = 0; row < retentionTable->rowCount(); ++row) {
+        const QString folder = retentionTable->item(row, 0)->text().trimmed();
+        RetentionRule rule;
+        rule.maxAgeDays = qMax(0, retentionTable->item(row, 1)->text().toInt());
+        rule.maxTotalMB =
+            qMax<qint64>(0, retentionTable->item(row, 2)->text().toLongLong());
+        rule.keepNewest = qMax(0, retentionTable->item(row, 3)->text().toInt());
+        if (folders.contains(folder) && rule.isActive()) {
+            rules[folder] = rule;
         }
     }
-    return patterns;
+    return rules;
+}
+
+void SettingsDialog::setViewMode(bool enabled, const QString& folder) {
+    viewModeCheck->setChecked(enabled);
+    viewFolderEdit->setText(folder);
+}
+
+bool SettingsDialog::getViewMode() const {
+    return viewModeCheck->isChecked();
+}
+
+QString SettingsDialog::getViewFolder() const {
+    return viewFolderEdit->text().trimmed();
+}
+
+void SettingsDialog::setLayoutOrderedCopies(bool enabled) {
+    layoutOrderCheck->setChecked(enabled);
+}
+
+bool SettingsDialog::getLayoutOrderedCopies() const {
+    return layoutOrderCheck->isChecked();
+}
+
+void SettingsDialog::setExtractArchives(bool enabled) {
+    extractArchivesCheck->setChecked(enabled);
+}
+
+bool SettingsDialog::getExtractArchives() const {
+    return extractArchivesCheck->isChecked();
+}
+
+void SettingsDialog::setDuplicateFolders(DuplicateFolders action) {
+    duplicateFoldersCombo->setCurrentIndex(
+        duplicateFoldersCombo->findData(int(action)));
+}
+
+DuplicateFolders SettingsDialog::getDuplicateFolders() const {
+    return DuplicateFolders(duplicateFoldersCombo->currentData().toInt());
 }
 
 bool SettingsDialog::getSettings(QWidget* parent,
@@ -128,47 +444,256 @@ bool SettingsDialog::getSettings(QWidget* parent,
     return false;
 }
 
-bool SettingsDialog::editSettings(QWidget* parent) {
+bool SettingsDialog::editSettings(QWidget* parent,
+                                  const QString& downloadFolder) {
     // Read current settings (seeds defaults if needed)
     SettingsData data = SettingsManager::read();
 
     SettingsDialog dialog(parent);
-    dialog.setMappings(data.mappings);
+    dialog.setMappings(data.mappings, data.destinationRoots,
+                       data.shardLayouts);
     dialog.setIgnorePatterns(data.ignorePatterns);
+    dialog.setColdStorageAgeDays(data.coldStorageAgeDays);
+    dialog.setRetentionRules(data.retention);
+    dialog.setViewMode(data.viewMode, data.viewFolder);
+    dialog.setLayoutOrderedCopies(data.layoutOrderedCopies);
+    dialog.setExtractArchives(data.extractArchives);
+    dialog.setDuplicateFolders(data.duplicateFolders);
+    dialog.setPreviewFolder(downloadFolder);
     if (dialog.exec() == QDialog::Accepted) {
+        // Roots and layouts of categories without a mapping row (e.g.
+        // Downloaded Folders) are only editable in the settings file; keep
+        // those
+        for (auto it = data.mappings.begin(); it != data.mappings.end();
+             ++it) {
+            data.destinationRoots.remove(it.key());
+            data.shardLayouts.remove(it.key());
+        }
         data.mappings = dialog.getMappings();
+        data.destinationRoots.insert(dialog.getDestinationRoots());
+        data.shardLayouts.insert(dialog.getShardLayouts());
         data.ignorePatterns = dialog.getIgnorePatterns();
+        data.coldStorageAgeDays = dialog.getColdStorageAgeDays();
+        data.retention = dialog.getRetentionRules();
+        data.viewMode = dialog.getViewMode();
+        data.viewFolder = dialog.getViewFolder();
+        data.layoutOrderedCopies = dialog.getLayoutOrderedCopies();
+        data.extractArchives = dialog.getExtractArchives();
+        data.duplicateFolders = dialog.getDuplicateFolders();
         return SettingsManager::write(data);
     }
     return false;
 }
 
 void SettingsDialog::addMapping() {
-    int row = mappingsTable->rowCount();
-    mappingsTable->insertRow(row);
-    mappingsTable->setItem(row, 0, new QTableWidgetItem("New Folder"));
-    mappingsTable->setItem(row, 1, new QTableWidgetItem("ext1, ext2"));
+    const int row = mappingsModel->addRow({"New Folder", {"ext1", "ext2"}});
+    const QModelIndex index = mappingsModel->index(row, 0);
+    mappingsView->scrollTo(index);
+    mappingsView->setCurrentIndex(index);
+    mappingsView->edit(index);
 }
 
 void SettingsDialog::removeMapping() {
-    int row = mappingsTable->currentRow();
-    if (row >= 0) {
-        mappingsTable->removeRow(row);
-    }
+    mappingsModel->removeViewRow(mappingsView->currentIndex().row());
 }
 
 void SettingsDialog::addIgnorePattern() {
-    // create an editable item and start inline editing immediately
-    QListWidgetItem* item = new QListWidgetItem("New Regex");
-    item->setFlags(item->flags() | Qt::ItemIsEditable);
-    ignoreList->addItem(item);
-    ignoreList->setCurrentItem(item);
-    ignoreList->editItem(item);
+    // add a row and start inline editing immediately
+    const int row = ignoreModel->addRow("New Regex");
+    const QModelIndex index = ignoreModel->index(row, 0);
+    ignoreView->scrollTo(index);
+    ignoreView->setCurrentIndex(index);
+    ignoreView->edit(index);
 }
 
 void SettingsDialog::removeIgnorePattern() {
-    int row = ignoreList->currentRow();
+    ignoreModel->removeViewRow(ignoreView->currentIndex().row());
+}
+
+// Copies of the rules are checked on the pool; only the newest result is
+// applied
+void SettingsDialog::validateRules() {
+    const int generation = ++validationGeneration;
+    const QVector<MappingsModel::Row> rows = mappingsModel->rows();
+    const QStringList patterns = ignoreModel->rows();
+    const int mappingsRevision = mappingsModel->revision();
+    const int ignoreRevision = ignoreModel->revision();
+
+    validationPool.start([this, generation, rows, patterns, mappingsRevision,
+                          ignoreRevision]() {
+        const QVector<QString> mappingProblems = MappingsModel::validate(rows);
+        const QVector<QString> ignoreProblems =
+            IgnorePatternsModel::validate(patterns);
+        QMetaObject::invokeMethod(
+            this,
+            [this, generation, mappingProblems, ignoreProblems,
+             mappingsRevision, ignoreRevision]() {
+                if (generation != validationGeneration)
+                    return;
+                mappingsModel->setProblems(mappingProblems, mappingsRevision);
+                ignoreModel->setProblems(ignoreProblems, ignoreRevision);
+                const int count = mappingsModel->problemCount() +
+                                  ignoreModel->problemCount();
+                problemsLabel->setText(
+                    QString("%1 rule(s) need attention; hover a red row for "
+                            "details.")
+                        .arg(count));
+                problemsLabel->setVisible(count > 0);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void SettingsDialog::addRetentionRule() {
+    int row = retentionTable->rowCount();
+    retentionTable->insertRow(row);
+    retentionTable->setItem(row, 0,
+                            new QTableWidgetItem("Downloaded Programs"));
+    retentionTable->setItem(row, 1, numberItem(90));
+    retentionTable->setItem(row, 2, numberItem(0));
+    retentionTable->setItem(row, 3, numberItem(0));
+}
+
+void SettingsDialog::removeRetentionRule() {
+    int row = retentionTable->currentRow();
     if (row >= 0) {
-        delete ignoreList->takeItem(row);
+        retentionTable->removeRow(row);
     }
 }
+
+void SettingsDialog::setPreviewFolder(const QString& folder) {
+    previewFolder = folder;
+    previewGroup->setVisible(!folder.isEmpty());
+    updatePreview();
+}
+
+// Classify the download folder's entries with the rules as they are on
+// screen right now, narrowed to the rule in the current row
+void SettingsDialog::updatePreview() {
+    if (previewFolder.isEmpty())
+        return;
+    const int generation = ++previewGeneration;
+
+    // Copy the rules, with the open editor's text in place of its cell
+    QVector<MappingsModel::Row> rows = mappingsModel->rows();
+    QStringList patterns = ignoreModel->rows();
+    if (editingIndex.isValid()) {
+        if (editingIndex.model() == mappingsModel) {
+            const int source = mappingsModel->sourceRow(editingIndex);
+            if (source >= 0 && editingIndex.column() == 0)
+                rows[source].folder = editingText.trimmed();
+            else if (source >= 0 && editingIndex.column() == 1)
+                rows[source].extensions =
+                    MappingsModel::parseExtensions(editingText);
+        } else {
+            const int source = ignoreModel->sourceRow(editingIndex);
+            if (source >= 0)
+                patterns[source] = editingText;
+        }
+    }
+
+    QMap<QString, QList<QString>> mappings;
+    for (const MappingsModel::Row& row : rows) {
+        if (!row.folder.isEmpty() && !row.extensions.isEmpty())
+            mappings[row.folder] = row.extensions;
+    }
+    // Empty patterns are dropped like the sorter does; remember which row
+    // each compiled expression came from
+    QList<QRegularExpression> expressions;
+    QVector<int> expressionRows;
+    for (int i = 0; i < patterns.size(); ++i) {
+        const QString trimmed = patterns[i].trimmed();
+        if (trimmed.isEmpty())
+            continue;
+        expressions.append(QRegularExpression(trimmed));
+        expressionRows.append(i);
+    }
+
+    QString focusFolder;
+    int focusPattern = -1;
+    if (previewIgnoreFocus) {
+        focusPattern = ignoreModel->sourceRow(ignoreView->currentIndex());
+    } else {
+        const int source =
+            mappingsModel->sourceRow(mappingsView->currentIndex());
+        if (source >= 0)
+            focusFolder = rows[source].folder;
+    }
+
+    const QString root = previewFolder;
+    previewPool.start([this, generation, root, mappings, expressions,
+                       expressionRows, patterns, focusFolder, focusPattern]() {
+        const auto entries = RulePreview::snapshot(root);
+        const RuleSet rules(mappings, expressions);
+        QVector<RuleSet::Decision> decisions;
+        if (!RulePreview::evaluate(*entries, rules, previewGeneration,
+                                   generation, &decisions))
+            return;
+
+        int moving = 0;
+        int ignored = 0;
+        int unrecognized = 0;
+        QVector<PreviewModel::Row> shown;
+        QHash<QString, QString> moveLabels;
+        for (qsizetype i = 0; i < entries->size(); ++i) {
+            const RuleSet::Decision& d = decisions[i];
+            const RulePreview::Entry& entry = (*entries)[i];
+            QString result;
+            switch (d.outcome) {
+                case RuleSet::Outcome::Move: {
+                    moving++;
+                    if (focusPattern >= 0 ||
+                        (!focusFolder.isEmpty() && d.folder != focusFolder))
+                        continue;
+                    auto label = moveLabels.find(d.folder);
+                    if (label == moveLabels.end())
+                        label = moveLabels.insert(d.folder, "-> " + d.folder);
+                    result = label.value();
+                    break;
+                }
+                case RuleSet::Outcome::Ignored: {
+                    ignored++;
+                    const int row = expressionRows[d.ignoreIndex];
+                    if (!focusFolder.isEmpty() ||
+                        (focusPattern >= 0 && row != focusPattern))
+                        continue;
+                    result = "ignored by " + patterns[row];
+                    break;
+                }
+                case RuleSet::Outcome::Unrecognized:
+                    unrecognized++;
+                    if (!focusFolder.isEmpty() || focusPattern >= 0)
+                        continue;
+                    result = QStringLiteral("stays (no matching rule)");
+                    break;
+                case RuleSet::Outcome::CategoryFolder:
+                    continue;
+            }
+            shown.append({entry.name, result});
+        }
+
+        QString summary =
+            QString("%1 entries in %2: %3 would move, %4 ignored, %5 "
+                    "unrecognized.")
+                .arg(entries->size())
+                .arg(root)
+                .arg(moving)
+                .arg(ignored)
+                .arg(unrecognized);
+        if (!focusFolder.isEmpty())
+            summary += QString(" Showing what goes to '%1'.").arg(focusFolder);
+        else if (focusPattern >= 0)
+            summary += QString(" Showing what '%1' ignores.")
+                           .arg(patterns.value(focusPattern));
+
+        QMetaObject::invokeMethod(
+            this,
+            [this, generation, shown = std::move(shown), summary]() mutable {
+                if (generation != previewGeneration)
+                    return;
+                previewModel->setRows(std::move(shown));
+                previewSummary->setText(summary);
+            },
+            Qt::QueuedConnection);
+    });
+}
@@ -0,0 +1,91 @@
+#include "../Include/DownloadSorter/SortClient.h"
+#include "../Include/DownloadSorter/SortService.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QProcess>
+
+SortClient::SortClient(QObject* parent) : QObject(parent) {
+    this->socket = new QLocalSocket(this);
+    QObject::connect(this->socket, &QLocalSocket::readyRead, this,
+                     &SortClient::onReadyRead);
+    QObject::connect(this->socket, &QLocalSocket::disconnected, this,
+                     &SortClient::disconnected);
+}
+
+void SortClient::connectToService() {
+    if (this->socket->state() != QLocalSocket::UnconnectedState)
+        return;
+    this->socket->connectToServer(SortService::serverName());
+}
+
+bool SortClient::waitForConnected(int msecs) {
+    return this->isConnected() || this->socket->waitForConnected(msecs);
+}
+
+bool SortClient::isConnected() const {
+    return this->socket->state() == QLocalSocket::ConnectedState;
+}
+
+bool SortClient::launchService() {
+    return QProcess::startDetached(QCoreApplication::applicationFilePath(),
+                                   {QStringLiteral("--service")});
+}
+
+void SortClient::sort(const QString& root) {
+    this->send({{"cmd", "sort"}, {"root", root}});
+}
+
+void SortClient::dryRun(const QString& root) {
+    this->send({{"cmd", "dry-run"}, {"root", root}});
+}
+
+void SortClient::cancel(const QString& root) {
+    this->send({{"cmd", "cancel"}, {"root", root}});
+}
+
+void SortClient::requestStatus() {
+    this->send({{"cmd", "status"}});
+}
+
+void SortClient::send(const QJsonObject& request) {
+    this->socket->write(QJsonDocument(request).toJson(QJsonDocument::Compact));
+    this->socket->write("\n");
+    this->socket->flush();
+}
+
+void SortClient::onReadyRead() {
+    while (this->socket->canReadLine()) {
+        const QJsonObject event =
+            QJsonDocument::fromJson(this->socket->readLine()).object();
+        const QString type = event.value("event").toString();
+
+        if (type == "range") {
+            emit progressRangeChanged(event.value("minimum").toInt(),
+                                      event.value("maximum").toInt());
+        } else if (type == "value") {
+            emit progressValueChanged(event.value("value").toInt());
+        } else if (type == "status") {
+            emit statusMessage(event.value("message").toString());
+        } else if (type == "plan" || type == "moved") {
+            QMap<QString, QString> moves;
+            for (const auto& v : event.value("moves").toArray()) {
+                const QJsonObject move = v.toObject();
+                moves.insert(move.value("from").toString(),
+                             move.value("to").toString());
+            }
+            if (type == "plan")
+                emit planReady(moves);
+            else
+                emit contentsMoved(moves);
+        } else if (type == "changed") {
+            emit categoriesChanged();
+        } else if (type == "jobs") {
+            emit statusReport(event.value("jobs").toArray());
+        } else if (type == "error") {
+            emit errorMessage(event.value("message").toString());
+        } else if (type == "finished") {
+            emit finished(event.value("completed").toBool(true));
+        }
+    }
+}
@@ -0,0 +1,264 @@
+#include "../Include/DownloadSorter/SortMetrics.h"
+
+#include <QtCore/QSaveFile>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+
+namespace {
+// errno values worth a label of their own; the rest count as "other"
+constexpr std::array<int, 7> knownErrors = {ENOENT, EACCES, EPERM, EEXIST,
+                                            EXDEV,  ENOSPC, EIO};
+constexpr std::array<const char*, 8> errorNames = {
+    "ENOENT", "EACCES", "EPERM", "EEXIST", "EXDEV", "ENOSPC", "EIO", "other"};
+
+using Counter = std::atomic<quint64>;
+
+// Only the owning thread writes a counter, so a load and a store is enough;
+// readers on other threads see either the old or the new value
+inline void bump(Counter& counter, quint64 by = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + by,
+                  std::memory_order_relaxed);
+}
+
+inline quint64 read(const Counter& counter) {
+    return counter.load(std::memory_order_relaxed);
+}
+
+// Label values are quoted; escape what the format requires
+QByteArray labelValue(const QString& value) {
+    QByteArray out = value.toUtf8();
+    out.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return out;
+}
+}  // namespace
+
+// Aligned so two threads never share a cache line
+struct alignas(64) SortMetrics::Shard {
+    std::array<Counter, categorySlots> files{};
+    std::array<Counter, categorySlots> bytes{};
+    Counter renames{0};
+    Counter copies{0};
+    std::array<Counter, errorSlots> failures{};
+    std::array<Counter, latencyBuckets> latency{};
+    Counter latencyNs{0};
+};
+
+// Hands its shard back when the thread ends
+struct SortMetrics::Lease {
+    Shard* shard = nullptr;
+
+    ~Lease() {
+        if (this->shard)
+            SortMetrics::instance().release(this->shard);
+    }
+};
+
+SortMetrics::SortMetrics() = default;
+SortMetrics::~SortMetrics() = default;
+
+SortMetrics& SortMetrics::instance() {
+    static SortMetrics metrics;
+    return metrics;
+}
+
+SortMetrics::Shard& SortMetrics::local() {
+    thread_local Lease lease;
+    if (!lease.shard) {
+        QMutexLocker lock(&this->registry);
+        if (!this->idle.empty()) {
+            lease.shard = this->idle.back();
+            this->idle.pop_back();
+        } else {
+            this->shards.push_back(std::make_unique<Shard>());
+            lease.shard = this->shards.back().get();
+        }
+    }
+    return *lease.shard;
+}
+
+int SortMetrics::categorySlot(const QString& category) {
+    thread_local QHash<QString, int> cached;
+    const auto hit = cached.constFind(category);
+    if (hit != cached.constEnd())
+        return hit.value();
+
+    QMutexLocker lock(&this->registry);
+    int slot = this->slotByCategory.value(category, -1);
+    if (slot < 0) {
+        slot = std::min<int>(this->categories.size(), categorySlots - 1);
+        if (slot < categorySlots - 1) {
+            this->categories.append(category);
+        } else if (this->categories.size() < categorySlots) {
+            this->categories.append(QStringLiteral("(other)"));
+        }
+        this->slotByCategory.insert(category, slot);
+    }
+    lock.unlock();
+    cached.insert(category, slot);
+    return slot;
+}
+
+void SortMetrics::release(Shard* shard) {
+    // Counts stay in the shard; the next thread carries on from them
+    QMutexLocker lock(&this->registry);
+    this->idle.push_back(shard);
+}
+
+void SortMetrics::recordMove(const QString& category,
+                             qint64 bytes,
+                             bool copied,
+                             qint64 nanoseconds) {
+    const int slot = this->categorySlot(category);
+    Shard& shard = this->local();
+    bump(shard.files[slot]);
+    bump(shard.bytes[slot], static_cast<quint64>(std::max<qint64>(bytes, 0)));
+    bump(copied ? shard.copies : shard.renames);
+
+    // Bucket i holds durations below 2^i microseconds
+    const quint64 ns = static_cast<quint64>(std::max<qint64>(nanoseconds, 0));
+    int bucket = 0;
+    while (bucket < latencyBuckets - 1 && (quint64(1) << bucket) <= ns / 1000)
+        bucket++;
+    bump(shard.latency[bucket]);
+    bump(shard.latencyNs, ns);
+}
+
+void SortMetrics::recordFailure(int error) {
+    int slot = errorSlots - 1;
+    for (size_t i = 0; i < knownErrors.size(); ++i) {
+        if (knownErrors[i] == error) {
+            slot = static_cast<int>(i);
+            break;
+        }
+    }
+    bump(this->local().failures[slot]);
+}
+
+QByteArray SortMetrics::exposition() const {
+    std::array<quint64, categorySlots> files{};
+    std::array<quint64, categorySlots> bytes{};
+    std::array<quint64, errorSlots> failures{};
+    std::array<quint64, latencyBuckets> latency{};
+    quint64 renames = 0, copies = 0, latencyNs = 0;
+    QStringList names;
+    {
+        QMutexLocker lock(&this->registry);
+        names = this->categories;
+        for (const auto& shard : this->shards) {
+            for (int i = 0; i < categorySlots; ++i) {
+                files[i] += read(shard->files[i]);
+                bytes[i] += read(shard->bytes[i]);
+            }
+            for (int i = 0; i < errorSlots; ++i)
+                failures[i] += read(shard->failures[i]);
+            for (int i = 0; i < latencyBuckets; ++i)
+                latency[i] += read(shard->latency[i]);
+            renames += read(shard->renames);
+            copies += read(shard->copies);
+            latencyNs += read(shard->latencyNs);
+        }
+    }
+
+    QByteArray out;
+    out += "# HELP downloadsorter_moved_files_total Files and folders moved.\n"
+           "# TYPE downloadsorter_moved_files_total counter\n";
+    for (int i = 0; i < names.size(); ++i)
+        out += "downloadsorter_moved_files_total{category=\"" +
+               labelValue(names[i]) + "\"} " + QByteArray::number(files[i]) +
+               '\n';
+    out += "# HELP downloadsorter_moved_bytes_total Bytes moved.\n"
+           "# TYPE downloadsorter_moved_bytes_total counter\n";
+    for (int i = 0; i < names.size(); ++i)
+        out += "downloadsorter_moved_bytes_total{category=\"" +
+               labelValue(names[i]) + "\"} " + QByteArray::number(bytes[i]) +
+               '\n';
+
+    out += "# HELP downloadsorter_moves_total Moves by how they were done.\n"
+           "# TYPE downloadsorter_moves_total counter\n"
+           "downloadsorter_moves_total{method=\"rename\"} " +
+           QByteArray::number(renames) +
+           "\n"
+           "downloadsorter_moves_total{method=\"copy\"} " +
+           QByteArray::number(copies) + '\n';
+
+    out += "# HELP downloadsorter_move_failures_total Moves that failed.\n"
+           "# TYPE downloadsorter_move_failures_total counter\n";
+    for (int i = 0; i < errorSlots; ++i)
+        out += QByteArray("downloadsorter_move_failures_total{error=\"") +
+               errorNames[i] + "\"} " + QByteArray::number(failures[i]) + '\n';
+
+    out += "# HELP downloadsorter_queue_depth Planned moves not yet done.\n"
+           "# TYPE downloadsorter_queue_depth gauge\n"
+           "downloadsorter_queue_depth " +
+           QByteArray::number(this->queued.load()) + '\n';
+
+    out += "# HELP downloadsorter_move_concurrency Moves in flight per device "
+           "chosen by the last sort.\n"
+           "# TYPE downloadsorter_move_concurrency gauge\n"
+           "downloadsorter_move_concurrency{method=\"rename\"} " +
+           QByteArray::number(this->renameConcurrency.load()) +
+           "\n"
+           "downloadsorter_move_concurrency{method=\"copy\"} " +
+           QByteArray::number(this->copyConcurrency.load()) + '\n';
+
+    quint64 count = 0;
+    for (quint64 n : latency)
+        count += n;
+    const double sum = latencyNs / 1e9;
+
+    out += "# HELP downloadsorter_move_duration_seconds Time per move.\n"
+           "# TYPE downloadsorter_move_duration_seconds histogram\n";
+    quint64 cumulative = 0;
+    for (int i = 0; i < latencyBuckets - 1; ++i) {
+        cumulative += latency[i];
+        out += "downloadsorter_move_duration_seconds_bucket{le=\"" +
+               QByteArray::number((quint64(1) << i) / 1e6, 'g', 10) + "\"} " +
+               QByteArray::number(cumulative) + '\n';
+    }
+    out += "downloadsorter_move_duration_seconds_bucket{le=\"+Inf\"} " +
+           QByteArray::number(count) + '\n';
+    out += "downloadsorter_move_duration_seconds_sum " +
+           QByteArray::number(sum, 'g', 10) + '\n';
+    out += "downloadsorter_move_duration_seconds_count " +
+           QByteArray::number(count) + '\n';
+
+    // Quantiles interpolated inside the bucket they fall in, so they are
+    // accurate to within a factor of two
+    auto quantile = [&](double q) {
+        if (count == 0)
+            return 0.0;
+        const double rank = q * count;
+        quint64 below = 0;
+        for (int i = 0; i < latencyBuckets; ++i) {
+            if (below + latency[i] >= rank && latency[i] > 0) {
+                const double low = i == 0 ? 0.0 : (quint64(1) << (i - 1));
+                const double high = quint64(1) << i;
+                return (low + (high - low) * (rank - below) / latency[i]) / 1e6;
+            }
+            below += latency[i];
+        }
+        return (quint64(1) << (latencyBuckets - 1)) / 1e6;
+    };
+    out += "# HELP downloadsorter_move_latency_seconds Time per move, "
+           "estimated from the histogram.\n"
+           "# TYPE downloadsorter_move_latency_seconds summary\n";
+    out += "downloadsorter_move_latency_seconds{quantile=\"0.5\"} " +
+           QByteArray::number(quantile(0.5), 'g', 6) + '\n';
+    out += "downloadsorter_move_latency_seconds{quantile=\"0.99\"} " +
+           QByteArray::number(quantile(0.99), 'g', 6) + '\n';
+    out += "downloadsorter_move_latency_seconds_sum " +
+           QByteArray::number(sum, 'g', 10) + '\n';
+    out += "downloadsorter_move_latency_seconds_count " +
+           QByteArray::number(count) + '\n';
+    return out;
+}
+
+bool SortMetrics::writeTo(const QString& path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(this->exposition());
+    return file.commit();
+}
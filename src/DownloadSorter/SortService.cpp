@@ -0,0 +1,317 @@
+#include "../Include/DownloadSorter/SortService.h"
+#include "../Include/DownloadSorter/SettingsManager.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+
+#include <utility>
+
+namespace {
+constexpr int idleTimeoutMs = 10 * 60 * 1000;
+}
+
+SortService::SortService(QObject* parent) : QObject(parent) {
+    this->server = new QLocalServer(this);
+    this->server->setSocketOptions(QLocalServer::UserAccessOption);
+    QObject::connect(this->server, &QLocalServer::newConnection, this,
+                     &SortService::onNewConnection);
+
+    this->idleTimer = new QTimer(this);
+    this->idleTimer->setSingleShot(true);
+    this->idleTimer->setInterval(idleTimeoutMs);
+    QObject::connect(this->idleTimer, &QTimer::timeout, this, []() {
+        QCoreApplication::quit();
+    });
+}
+
+SortService::~SortService() {
+    for (auto it = this->jobs.begin(); it != this->jobs.end(); ++it) {
+        it->sorter->requestInterruption();
+        it->sorter->wait();
+        delete it->sorter;
+    }
+}
+
+QString SortService::serverName() {
+    QString user = qEnvironmentVariable("USER");
+    if (user.isEmpty())
+        user = qEnvironmentVariable("USERNAME");
+    return QStringLiteral("DownloadSorter-%1").arg(user);
+}
+
+bool SortService::listen() {
+    const QString name = serverName();
+    if (this->server->listen(name)) {
+        this->updateIdleTimer();
+        return true;
+    }
+
+    // A crashed instance can leave a stale socket behind; only clear it if
+    // nobody answers on it
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(200))
+        return false;
+
+    QLocalServer::removeServer(name);
+    if (!this->server->listen(name))
+        return false;
+    this->updateIdleTimer();
+    return true;
+}
+
+QString SortService::jobKey(const QString& root) {
+    QString key = QDir::cleanPath(QFileInfo(root).absoluteFilePath());
+#ifdef Q_OS_WIN
+    key = key.toLower();
+#endif
+    return key;
+}
+
+void SortService::send(QLocalSocket* socket, const QJsonObject& event) {
+    if (!socket || socket->state() != QLocalSocket::ConnectedState)
+        return;
+    socket->write(QJsonDocument(event).toJson(QJsonDocument::Compact));
+    socket->write("\n");
+}
+
+void SortService::onNewConnection() {
+    while (this->server->hasPendingConnections()) {
+        QLocalSocket* socket = this->server->nextPendingConnection();
+        this->connections++;
+        QObject::connect(socket, &QLocalSocket::readyRead, this,
+                         [this, socket]() { this->onReadyRead(socket); });
+        QObject::connect(socket, &QLocalSocket::disconnected, this,
+                         [this, socket]() {
+                             this->connections--;
+                             socket->deleteLater();
+                             this->updateIdleTimer();
+                         });
+    }
+    this->updateIdleTimer();
+}
+
+void SortService::onReadyRead(QLocalSocket* socket) {
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+
+        QJsonParseError error;
+        const QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+        if (!doc.isObject()) {
+            send(socket, {{"event", "error"},
+                          {"message", QStringLiteral("Malformed request: %1")
+                                          .arg(error.errorString())}});
+            continue;
+        }
+        this->handleRequest(socket, doc.object());
+    }
+}
+
+void SortService::handleRequest(QLocalSocket* socket,
+                                const QJsonObject& request) {
+    const QString cmd = request.value("cmd").toString();
+    const QString root = request.value("root").toString();
+
+    if (cmd == "status") {
+        this->reportJobs(socket);
+    } else if (root.isEmpty()) {
+        send(socket, {{"event", "error"},
+                      {"message", QStringLiteral("'%1' needs a root folder.")
+                                      .arg(cmd)}});
+    } else if (cmd == "sort" || cmd == "dry-run") {
+        this->startJob(socket, root, cmd == "dry-run");
+    } else if (cmd == "cancel") {
+        this->cancelJob(socket, root);
+    } else {
+        send(socket,
+             {{"event", "error"},
+              {"message", QStringLiteral("Unknown command '%1'.").arg(cmd)}});
+    }
+}
+
+void SortService::reloadSettingsIfChanged() {
+    const QDateTime stamp =
+        QFileInfo(SettingsManager::configPath()).lastModified();
+    if (stamp.isValid() && stamp == this->settingsStamp)
+        return;
+
+    this->settings = SettingsManager::read();
+    this->compiledIgnorePatterns =
+        DownloadSorter::compileIgnorePatterns(this->settings.ignorePatterns);
+    this->settingsStamp =
+        QFileInfo(SettingsManager::configPath()).lastModified();
+}
+
+void SortService::startJob(QLocalSocket* socket,
+                           const QString& root,
+                           bool dryRun) {
+    const QString key = jobKey(root);
+
+    auto existing = this->jobs.find(key);
+    if (existing != this->jobs.end()) {
+        if (existing->dryRun != dryRun) {
+            send(socket,
+                 {{"event", "error"},
+                  {"root", root},
+                  {"message",
+                   QStringLiteral("A %1 is already running for '%2'.")
+                       .arg(existing->dryRun ? QStringLiteral("dry run")
+                                             : QStringLiteral("sort"),
+                            root)}});
+            return;
+        }
+
+        // Duplicate request: join the running job and catch up on its state
+        if (!existing->clients.contains(socket))
+            existing->clients.append(socket);
+        send(socket, {{"event", "range"},
+                      {"root", existing->root},
+                      {"minimum", existing->minimum},
+                      {"maximum", existing->maximum}});
+        send(socket, {{"event", "value"},
+                      {"root", existing->root},
+                      {"value", existing->value}});
+        if (!existing->message.isEmpty())
+            send(socket, {{"event", "status"},
+                          {"root", existing->root},
+                          {"message", existing->message}});
+        return;
+    }
+
+    this->reloadSettingsIfChanged();
+
+    auto* sorter = new DownloadSorter(root);
+    sorter->setFileTypesMap(this->settings.mappings);
+    sorter->setIgnoreExpressions(this->compiledIgnorePatterns);
+    sorter->setColdStorageAgeDays(this->settings.coldStorageAgeDays);
+    sorter->setRetentionRules(this->settings.retention);
+    sorter->setViewMode(this->settings.viewMode, this->settings.viewFolder);
+    sorter->setDestinationRoots(this->settings.destinationRoots);
+    sorter->setShardLayouts(this->settings.shardLayouts);
+    sorter->setLayoutOrderedCopies(this->settings.layoutOrderedCopies);
+    sorter->setExtractArchives(this->settings.extractArchives);
+    sorter->setDuplicateFolders(this->settings.duplicateFolders);
+    sorter->setDryRun(dryRun);
+
+    Job job;
+    job.sorter = sorter;
+    job.root = root;
+    job.dryRun = dryRun;
+    job.clients.append(socket);
+    this->jobs.insert(key, job);
+
+    QObject::connect(sorter, &DownloadSorter::progressRangeChanged, this,
+                     [this, key](int minimum, int maximum) {
+                         auto it = this->jobs.find(key);
+                         if (it == this->jobs.end())
+                             return;
+                         it->minimum = minimum;
+                         it->maximum = maximum;
+                         this->broadcast(key, {{"event", "range"},
+                                               {"minimum", minimum},
+                                               {"maximum", maximum}});
+                     });
+    QObject::connect(sorter, &DownloadSorter::progressValueChanged, this,
+                     [this, key](int value) {
+                         auto it = this->jobs.find(key);
+                         if (it == this->jobs.end())
+                             return;
+                         it->value = value;
+                         this->broadcast(
+                             key, {{"event", "value"}, {"value", value}});
+                     });
+    QObject::connect(sorter, &DownloadSorter::statusMessage, this,
+                     [this, key](const QString& message) {
+                         auto it = this->jobs.find(key);
+                         if (it == this->jobs.end())
+                             return;
+                         it->message = message;
+                         this->broadcast(
+                             key, {{"event", "status"}, {"message", message}});
+                     });
+    QObject::connect(sorter, &DownloadSorter::planReady, this,
+                     [this, key](const QMap<QString, QString>& plan) {
+                         QJsonArray moves;
+                         for (auto it = plan.begin(); it != plan.end(); ++it)
+                             moves.append(QJsonObject{{"from", it.key()},
+                                                      {"to", it.value()}});
+                         this->broadcast(
+                             key, {{"event", "plan"}, {"moves", moves}});
+                     });
+    QObject::connect(sorter, &DownloadSorter::contentsMoved, this,
+                     [this, key](const QMap<QString, QString>& moved) {
+                         QJsonArray moves;
+                         for (auto it = moved.begin(); it != moved.end(); ++it)
+                             moves.append(QJsonObject{{"from", it.key()},
+                                                      {"to", it.value()}});
+                         this->broadcast(
+                             key, {{"event", "moved"}, {"moves", moves}});
+                     });
+    QObject::connect(sorter, &DownloadSorter::categoriesChanged, this,
+                     [this, key]() {
+                         this->broadcast(key, {{"event", "changed"}});
+                     });
+    QObject::connect(sorter, &QThread::finished, this, [this, key, sorter]() {
+        this->broadcast(key, {{"event", "finished"},
+                              {"completed", sorter->completed()}});
+        const Job job = this->jobs.take(key);
+        job.sorter->deleteLater();
+        this->updateIdleTimer();
+    });
+
+    this->updateIdleTimer();
+    sorter->start();
+}
+
+void SortService::cancelJob(QLocalSocket* socket, const QString& root) {
+    auto it = this->jobs.find(jobKey(root));
+    if (it == this->jobs.end()) {
+        send(socket,
+             {{"event", "error"},
+              {"root", root},
+              {"message",
+               QStringLiteral("Nothing is running for '%1'.").arg(root)}});
+        return;
+    }
+    it->sorter->requestInterruption();
+    send(socket, {{"event", "status"},
+                  {"root", it->root},
+                  {"message", QStringLiteral("Cancelling...")}});
+}
+
+void SortService::reportJobs(QLocalSocket* socket) {
+    QJsonArray list;
+    for (auto it = this->jobs.constBegin(); it != this->jobs.constEnd();
+         ++it) {
+        list.append(QJsonObject{
+            {"root", it->root},
+            {"kind", it->dryRun ? "dry-run" : "sort"},
+            {"value", it->value},
+            {"maximum", it->maximum},
+            {"message", it->message},
+            {"clients", int(it->clients.size())},
+        });
+    }
+    send(socket, {{"event", "jobs"}, {"jobs", list}});
+}
+
+void SortService::broadcast(const QString& key, QJsonObject event) {
+    auto it = this->jobs.find(key);
+    if (it == this->jobs.end())
+        return;
+    event.insert("root", it->root);
+    for (const QPointer<QLocalSocket>& client : std::as_const(it->clients))
+        send(client, event);
+}
+
+void SortService::updateIdleTimer() {
+    if (this->jobs.isEmpty() && this->connections <= 0)
+        this->idleTimer->start();
+    else
+        this->idleTimer->stop();
+}
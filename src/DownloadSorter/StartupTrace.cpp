@@ -0,0 +1,64 @@
+#include "../Include/DownloadSorter/StartupTrace.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEvent>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtWidgets/QWidget>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+QElapsedTimer startClock;
+bool tracing = false;
+
+// Watches a window for its first paint, then gets out of the way
+class FirstFrameFilter : public QObject {
+   public:
+    FirstFrameFilter(QWidget* window, std::function<void()> then)
+        : QObject(window), then(std::move(then)) {}
+
+    bool eventFilter(QObject* watched, QEvent* event) override {
+        if (event->type() == QEvent::Paint && this->then) {
+            watched->removeEventFilter(this);
+            // Let the paint finish and reach the screen before anything else
+            QTimer::singleShot(0, watched, [then = std::move(this->then)]() {
+                StartupTrace::mark("first frame");
+                then();
+            });
+            this->deleteLater();
+        }
+        return false;
+    }
+
+   private:
+    std::function<void()> then;
+};
+}  // namespace
+
+void StartupTrace::begin(int argc, char* argv[]) {
+    startClock.start();
+    const char* env = std::getenv("DOWNLOADSORTER_TRACE_STARTUP");
+    tracing = env && *env && std::strcmp(env, "0") != 0;
+    for (int i = 1; i < argc && !tracing; ++i)
+        tracing = std::strcmp(argv[i], "--trace-startup") == 0;
+}
+
+bool StartupTrace::enabled() {
+    return tracing;
+}
+
+void StartupTrace::mark(const char* label) {
+    if (!tracing)
+        return;
+    // stderr directly: the message handler may not be set up yet
+    std::fprintf(stderr, "[startup] %7.2f ms  %s\n",
+                 startClock.nsecsElapsed() / 1e6, label);
+}
+
+void StartupTrace::onFirstFrame(QWidget* window, std::function<void()> then) {
+    window->installEventFilter(new FirstFrameFilter(window, std::move(then)));
+}
@@ -0,0 +1,227 @@
+#include "../Include/DownloadSorter/StorageStats.h"
+#include "../Include/DownloadSorter/SettingsManager.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+
+#include <vector>
+
+namespace {
+constexpr qint64 msecsPerDay = 24LL * 60 * 60 * 1000;
+// Numbers older than this get a full re-walk on the next sort
+constexpr qint64 reconcileIntervalDays = 1;
+
+qint64 dayOf(const QDateTime& time) {
+    return time.toMSecsSinceEpoch() / msecsPerDay;
+}
+
+void add(StorageStats::Category& c, int bucket, qint64 size, qint64 day) {
+    c.count++;
+    c.bytes += size;
+    c.sizes[bucket]++;
+    c.days[day]++;
+}
+}  // namespace
+
+QString StorageStats::statsPath(const QString& root) {
+    return SettingsManager::dataPath(
+        QStringLiteral("stats-%1.json").arg(SettingsManager::rootKey(root)));
+}
+
+int StorageStats::sizeBucket(qint64 size) {
+    int bucket = 0;
+    for (qint64 limit = 4096; size >= limit && bucket < sizeBucketCount - 1;
+         limit *= 16)
+        bucket++;
+    return bucket;
+}
+
+QString StorageStats::sizeBucketLabel(int bucket) {
+    static const char* const labels[sizeBucketCount] = {
+        "< 4 KiB",   "< 64 KiB", "< 1 MiB", "< 16 MiB",
+        "< 256 MiB", "< 4 GiB",  ">= 4 GiB"};
+    return QString::fromLatin1(labels[bucket]);
+}
+
+QString StorageStats::ageBucketLabel(int bucket) {
+    static const char* const labels[ageBucketCount] = {
+        "< 1 day", "< 1 week", "< 1 month", "< 3 months", "< 1 year", "older"};
+    return QString::fromLatin1(labels[bucket]);
+}
+
+std::array<qint64, StorageStats::ageBucketCount> StorageStats::ageHistogram(
+    const Category& category) {
+    static const qint64 limits[ageBucketCount - 1] = {1, 7, 30, 91, 365};
+    std::array<qint64, ageBucketCount> histogram{};
+    const qint64 today = dayOf(QDateTime::currentDateTime());
+    for (auto it = category.days.begin(); it != category.days.end(); ++it) {
+        const qint64 age = today - it.key();
+        int bucket = 0;
+        while (bucket < ageBucketCount - 1 && age >= limits[bucket])
+            bucket++;
+        histogram[bucket] += it.value();
+    }
+    return histogram;
+}
+
+qint64 StorageStats::entrySize(const QString& path) {
+    const QFileInfo info(path);
+    if (!info.isDir() || info.isSymLink())
+        return info.size();
+
+    qint64 total = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::System,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        total += it.fileInfo().size();
+    }
+    return total;
+}
+
+void StorageStats::record(const QString& category,
+                          qint64 size,
+                          const QDateTime& mtime) {
+    add(this->stats[category], sizeBucket(size), size, dayOf(mtime));
+}
+
+bool StorageStats::needsReconcile() const {
+    return !this->reconciled.isValid() ||
+           this->reconciled.daysTo(QDateTime::currentDateTime()) >=
+               reconcileIntervalDays;
+}
+
+void StorageStats::reconcile(const QStringList& categoryFolders,
+                             const QMap<QString, ShardLayout>& shardLayouts) {
+    struct PendingDir {
+        QString category;
+        QString path;
+        qint64 day;
+    };
+
+    // Files are counted straight from the listing; directories need a walk
+    QMap<QString, Category> fresh;
+    QList<PendingDir> dirs;
+    for (const QString& folder : categoryFolders) {
+        const QDir dir(folder);
+        if (!dir.exists())
+            continue;
+        const QString name = dir.dirName();
+        const ShardLayout layout = shardLayouts.value(name);
+        Category& c = fresh[name];
+        QList<QPair<QString, int>> levels = {{dir.absolutePath(), 0}};
+        while (!levels.isEmpty()) {
+            const auto [path, level] = levels.takeLast();
+            for (const QFileInfo& info : QDir(path).entryInfoList(
+                     QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot)) {
+                const bool isDir = info.isDir() && !info.isSymLink();
+                if (isDir && level < layout.depth() &&
+                    layout.isShardName(info.fileName(), level)) {
+                    levels.append({info.absoluteFilePath(), level + 1});
+                    continue;
+                }
+                const qint64 day = dayOf(info.lastModified());
+                if (isDir)
+                    dirs.append({name, info.absoluteFilePath(), day});
+                else
+                    add(c, sizeBucket(info.size()), info.size(), day);
+            }
+        }
+    }
+
+    std::vector<qint64> sizes(dirs.size());
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (qsizetype i = 0; i < dirs.size(); ++i) {
+        pool.start([&sizes, &dirs, i]() {
+            sizes[i] = entrySize(dirs[i].path);
+        });
+    }
+    pool.waitForDone();
+
+    for (qsizetype i = 0; i < dirs.size(); ++i)
+        add(fresh[dirs[i].category], sizeBucket(sizes[i]), sizes[i],
+            dirs[i].day);
+
+    for (auto it = fresh.begin(); it != fresh.end(); ++it)
+        this->stats.insert(it.key(), it.value());
+    this->reconciled = QDateTime::currentDateTime();
+}
+
+bool StorageStats::load(const QString& root) {
+    this->root = root;
+    this->stats.clear();
+    this->reconciled = QDateTime();
+
+    QFile f(statsPath(root));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    const auto doc = QJsonDocument::fromJson(f.readAll());
+    f.close();
+    if (!doc.isObject())
+        return false;
+
+    const QJsonObject obj = doc.object();
+    const qint64 stamp = obj.value(QStringLiteral("reconciled")).toInteger();
+    if (stamp > 0)
+        this->reconciled = QDateTime::fromMSecsSinceEpoch(stamp);
+
+    const QJsonObject categories =
+        obj.value(QStringLiteral("categories")).toObject();
+    for (auto it = categories.begin(); it != categories.end(); ++it) {
+        const QJsonObject o = it.value().toObject();
+        Category c;
+        c.count = o.value(QStringLiteral("count")).toInteger();
+        c.bytes = o.value(QStringLiteral("bytes")).toInteger();
+        const QJsonArray sizes = o.value(QStringLiteral("sizes")).toArray();
+        for (int i = 0; i < sizeBucketCount && i < sizes.size(); ++i)
+            c.sizes[i] = sizes[i].toInteger();
+        const QJsonObject days = o.value(QStringLiteral("days")).toObject();
+        for (auto d = days.begin(); d != days.end(); ++d)
+            c.days.insert(d.key().toLongLong(), d.value().toInteger());
+        this->stats.insert(it.key(), c);
+    }
+    return true;
+}
+
+bool StorageStats::save() const {
+    QJsonObject categories;
+    for (auto it = this->stats.begin(); it != this->stats.end(); ++it) {
+        const Category& c = it.value();
+        QJsonArray sizes;
+        for (qint64 n : c.sizes)
+            sizes.append(n);
+        QJsonObject days;
+        for (auto d = c.days.begin(); d != c.days.end(); ++d)
+            days.insert(QString::number(d.key()), d.value());
+
+        QJsonObject o;
+        o.insert(QStringLiteral("count"), c.count);
+        o.insert(QStringLiteral("bytes"), c.bytes);
+        o.insert(QStringLiteral("sizes"), sizes);
+        o.insert(QStringLiteral("days"), days);
+        categories.insert(it.key(), o);
+    }
+
+    QJsonObject obj;
+    obj.insert(QStringLiteral("root"), this->root);
+    obj.insert(QStringLiteral("reconciled"),
+               this->reconciled.isValid()
+                   ? this->reconciled.toMSecsSinceEpoch()
+                   : qint64(0));
+    obj.insert(QStringLiteral("categories"), categories);
+
+    QSaveFile f(statsPath(this->root));
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    f.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    return f.commit();
+}
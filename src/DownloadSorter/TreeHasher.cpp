@@ -0,0 +1,294 @@
+#include "../Include/DownloadSorter/TreeHasher.h"
+#include "../Include/DownloadSorter/SettingsManager.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr quint32 cacheMagic = 0x44535431;  // "DST1"
+constexpr qint64 secsPerDay = 24 * 60 * 60;
+// Cached hashes not looked at for this long are dropped on save
+constexpr qint64 cacheKeepDays = 30;
+constexpr qint64 readBufferSize = 1 << 20;
+
+fs::path toPath(const QString& path) {
+    return fs::path(path.toStdU16String());
+}
+
+qint64 today() {
+    return QDateTime::currentSecsSinceEpoch() / secsPerDay;
+}
+}  // namespace
+
+TreeHasher::TreeHasher(const QString& root, int maxThreads)
+    : cachePath(SettingsManager::dataPath(
+          QStringLiteral("trees-%1.bin").arg(SettingsManager::rootKey(root)))),
+      maxThreads(qMax(1, maxThreads)) {
+    QFile f(this->cachePath);
+    if (!f.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    qint64 count = 0;
+    in >> magic >> count;
+    if (magic != cacheMagic || count < 0)
+        return;
+    for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString path;
+        Cached c;
+        in >> path >> c.size >> c.modified >> c.used >> c.hash;
+        this->cache.insert(path, c);
+    }
+    if (in.status() != QDataStream::Ok)
+        this->cache.clear();
+}
+
+TreeHasher::Walk TreeHasher::walk(const QString& dir) {
+    Walk result;
+    const QString root = QDir::cleanPath(dir);
+    QDirIterator it(root,
+                    QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden |
+                        QDir::System,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        Node node;
+        node.rel = it.filePath().mid(root.size() + 1);
+        node.type = info.isSymLink() ? 'l' : info.isDir() ? 'd' : 'f';
+        node.size = node.type == 'f' ? info.size() : 0;
+        node.modified = info.lastModified().toMSecsSinceEpoch();
+        if (node.type == 'l') {
+            // The link text itself; a relative link resolves differently
+            // in each copy
+            std::error_code ec;
+            node.target = QString::fromStdU16String(
+                fs::read_symlink(toPath(it.filePath()), ec).u16string());
+        }
+        result.nodes.append(node);
+    }
+    std::sort(result.nodes.begin(), result.nodes.end(),
+              [](const Node& a, const Node& b) { return a.rel < b.rel; });
+
+    // Everything but the contents
+    QCryptographicHash shape(QCryptographicHash::Sha256);
+    for (const Node& node : result.nodes)
+        shape.addData(node.rel.toUtf8() + '\0' + node.type +
+                      QByteArray::number(node.size) + '\0' +
+                      node.target.toUtf8() + '\n');
+    result.shape = shape.result();
+    return result;
+}
+
+QString TreeHasher::findIdentical(const QString& dir,
+                                  const QStringList& candidates) {
+    // Anything that is not a directory on disk would walk as an empty tree
+    auto isTree = [](const QString& path) {
+        const QFileInfo info(path);
+        return info.isDir() && !info.isSymLink();
+    };
+    if (!isTree(dir))
+        return QString();
+
+    const Walk source = walk(dir);
+    QByteArray sourceHash;  // only worked out once some shape matches
+    for (const QString& candidate : candidates) {
+        if (!isTree(candidate))
+            continue;
+        const Walk other = walk(candidate);
+        if (other.shape != source.shape)
+            continue;
+        if (sourceHash.isEmpty())
+            sourceHash = this->merkle(dir, source.nodes);
+        if (sourceHash.isEmpty())
+            return QString();
+        if (this->merkle(candidate, other.nodes) == sourceHash)
+            return candidate;
+    }
+    return QString();
+}
+
+QByteArray TreeHasher::hash(const QString& dir) {
+    return this->merkle(dir, walk(dir).nodes);
+}
+
+bool TreeHasher::verifyIdentical(const QString& dir, const QString& other) {
+    const Walk a = walk(dir);
+    const Walk b = walk(other);
+    if (a.shape != b.shape)
+        return false;
+    const QByteArray hash = this->merkle(dir, a.nodes, false);
+    return !hash.isEmpty() && this->merkle(other, b.nodes, false) == hash;
+}
+
+QByteArray TreeHasher::merkle(const QString& dir,
+                              const QVector<Node>& nodes,
+                              bool useCache) {
+    // Files in parallel; links stand for their target text
+    QVector<QByteArray> hashes(nodes.size());
+    QByteArray* out = hashes.data();
+    std::atomic<bool> failed{false};
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(this->maxThreads);
+        for (qsizetype i = 0; i < nodes.size(); ++i) {
+            const Node& node = nodes[i];
+            if (node.type == 'l') {
+                out[i] = QCryptographicHash::hash(node.target.toUtf8(),
+                                                  QCryptographicHash::Sha256);
+            } else if (node.type == 'f') {
+                pool.start([this, &dir, &node, out, &failed, i, useCache]() {
+                    if (failed)
+                        return;
+                    out[i] =
+                        this->fileHash(dir + '/' + node.rel, node, useCache);
+                    if (out[i].isEmpty())
+                        failed = true;
+                });
+            }
+        }
+        pool.waitForDone();
+    }
+    if (failed)
+        return QByteArray();
+
+    // Children by parent; sorting by path kept siblings in name order
+    QHash<QString, QVector<qsizetype>> children;
+    QVector<qsizetype> dirs;
+    for (qsizetype i = 0; i < nodes.size(); ++i) {
+        const qsizetype slash = nodes[i].rel.lastIndexOf('/');
+        children[slash < 0 ? QString() : nodes[i].rel.left(slash)].append(i);
+        if (nodes[i].type == 'd')
+            dirs.append(i);
+    }
+    auto combine = [&](const QVector<qsizetype>& entries) {
+        QCryptographicHash h(QCryptographicHash::Sha256);
+        for (qsizetype c : entries) {
+            const QString& rel = nodes[c].rel;
+            const QByteArray name = rel.mid(rel.lastIndexOf('/') + 1).toUtf8();
+            h.addData(nodes[c].type + name + '\0' + hashes[c]);
+        }
+        return h.result();
+    };
+
+    // Deepest first, so each directory's subdirectories are done
+    std::sort(dirs.begin(), dirs.end(), [&nodes](qsizetype a, qsizetype b) {
+        return nodes[a].rel.count('/') > nodes[b].rel.count('/');
+    });
+    for (qsizetype d : dirs)
+        hashes[d] = combine(children.value(nodes[d].rel));
+    return combine(children.value(QString()));
+}
+
+QByteArray TreeHasher::fileHash(const QString& path,
+                                const Node& node,
+                                bool useCache) {
+    const qint64 day = today();
+    if (useCache) {
+        QMutexLocker lock(&this->mutex);
+        const auto it = this->cache.find(path);
+        if (it != this->cache.end() && it->size == node.size &&
+            it->modified == node.modified) {
+            if (it->used != day) {
+                it->used = day;
+                this->dirty = true;
+            }
+            return it->hash;
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    QCryptographicHash h(QCryptographicHash::Sha256);
+    std::vector<char> buffer(readBufferSize);
+    for (;;) {
+        const qint64 n = file.read(buffer.data(), readBufferSize);
+        if (n < 0)
+            return QByteArray();
+        if (n == 0)
+            break;
+        h.addData(QByteArray::fromRawData(buffer.data(), n));
+    }
+    const QByteArray result = h.result();
+
+    QMutexLocker lock(&this->mutex);
+    this->cache.insert(path, {node.size, node.modified, day, result});
+    this->dirty = true;
+    return result;
+}
+
+bool TreeHasher::save() {
+    QMutexLocker lock(&this->mutex);
+    if (!this->dirty)
+        return true;
+
+    const qint64 stale = today() - cacheKeepDays;
+    for (auto it = this->cache.begin(); it != this->cache.end();) {
+        if (it->used < stale)
+            it = this->cache.erase(it);
+        else
+            ++it;
+    }
+
+    QSaveFile f(this->cachePath);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << cacheMagic << qint64(this->cache.size());
+    for (auto it = this->cache.cbegin(); it != this->cache.cend(); ++it)
+        out << it.key() << it->size << it->modified << it->used << it->hash;
+    if (out.status() != QDataStream::Ok || !f.commit())
+        return false;
+    this->dirty = false;
+    return true;
+}
+
+int TreeHasher::linkTree(const QString& original, const QString& to) {
+    const fs::path from = toPath(original);
+    const fs::path target = toPath(to);
+    std::error_code ec;
+    if (fs::exists(target, ec))
+        return EEXIST;
+
+    fs::create_directory(target, from, ec);
+    for (auto it = fs::recursive_directory_iterator(from, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        const fs::path dest = target / it->path().lexically_relative(from);
+        if (it->is_symlink(ec))
+            fs::copy_symlink(it->path(), dest, ec);
+        else if (it->is_directory(ec))
+            fs::create_directory(dest, it->path(), ec);
+        else if (!ec)
+            fs::create_hard_link(it->path(), dest, ec);
+    }
+    if (!ec)
+        return 0;
+
+    const std::error_condition condition = ec.default_error_condition();
+    std::error_code ignored;
+    fs::remove_all(target, ignored);
+    return condition.category() == std::generic_category() &&
+                   condition.value() != 0
+               ? condition.value()
+               : EIO;
+}
@@ -0,0 +1,319 @@
+#include "../Include/DownloadSorter/TreeTransfer.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDebug>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#include <system_error>
+#endif
+
+namespace {
+#ifndef Q_OS_WIN
+constexpr size_t copyBufferSize = 1 << 20;
+// Source entries are unlinked in groups of this many per task
+constexpr qsizetype unlinkBatchSize = 1024;
+
+QByteArray native(const QString& path) {
+    return QFile::encodeName(path);
+}
+
+void timesOf(const struct stat& st, struct timespec times[2]) {
+#ifdef Q_OS_DARWIN
+    times[0] = st.st_atimespec;
+    times[1] = st.st_mtimespec;
+#else
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+#endif
+}
+
+// Copy one regular file, then give it the source's mode and times, flush it
+// and check its size. A failed copy is deleted.
+int copyFile(const QByteArray& from, const QByteArray& to,
+             const struct stat& st) {
+    const int in = ::open(from.constData(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (in < 0)
+        return errno;
+    const int out = ::open(to.constData(),
+                           O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (out < 0) {
+        const int error = errno;
+        ::close(in);
+        return error;
+    }
+
+    int error = 0;
+    bool finished = false;
+#ifdef Q_OS_LINUX
+    // In-kernel copy (reflinks or server-side copies where possible); any
+    // refusal falls through to the plain loop, which carries on from the
+    // current offsets
+    while (!finished) {
+        const ssize_t n =
+            ::copy_file_range(in, nullptr, out, nullptr, 1 << 30, 0);
+        if (n == 0)
+            finished = true;
+        else if (n < 0 && errno != EINTR)
+            break;
+    }
+#endif
+    std::vector<char> buffer;
+    if (!finished)
+        buffer.resize(copyBufferSize);
+    while (!finished && error == 0) {
+        const ssize_t n = ::read(in, buffer.data(), buffer.size());
+        if (n == 0)
+            break;
+        if (n < 0) {
+            if (errno != EINTR)
+                error = errno;
+            continue;
+        }
+        for (ssize_t done = 0; done < n && error == 0;) {
+            const ssize_t w = ::write(out, buffer.data() + done, n - done);
+            if (w >= 0)
+                done += w;
+            else if (errno != EINTR)
+                error = errno;
+        }
+    }
+
+    if (error == 0) {
+        struct timespec times[2];
+        timesOf(st, times);
+        // fchmod, unlike open's mode, is not narrowed by the umask
+        if (::fchmod(out, st.st_mode & 07777) != 0 ||
+            ::futimens(out, times) != 0)
+            error = errno;
+    }
+    // The source goes away afterwards, so the data has to be on disk
+    if (error == 0 && ::fsync(out) != 0)
+        error = errno;
+    struct stat written;
+    if (error == 0 &&
+        (::fstat(out, &written) != 0 || written.st_size != st.st_size))
+        error = EIO;
+    if (::close(out) != 0 && error == 0)
+        error = errno;
+    ::close(in);
+    if (error != 0)
+        ::unlink(to.constData());
+    return error;
+}
+
+int copyLink(const QByteArray& from, const QByteArray& to,
+             const struct stat& st) {
+    QByteArray target(std::max<qint64>(st.st_size, 255) + 1, '\0');
+    const ssize_t n =
+        ::readlink(from.constData(), target.data(), target.size());
+    if (n < 0)
+        return errno;
+    target.truncate(n);
+    if (::symlink(target.constData(), to.constData()) != 0)
+        return errno;
+    struct timespec times[2];
+    timesOf(st, times);
+    ::utimensat(AT_FDCWD, to.constData(), times, AT_SYMLINK_NOFOLLOW);
+    return 0;
+}
+#endif
+}  // namespace
+
+TreeTransfer::TreeTransfer(int maxThreads) : maxThreads(qMax(1, maxThreads)) {}
+
+TreeTransfer::Result TreeTransfer::move(const QString& from,
+                                        const QString& to) const {
+    Result result;
+#ifndef Q_OS_WIN
+    struct Dir {
+        QByteArray rel;  // "" for the root, "/a/b" below it
+        struct stat st;
+    };
+
+    const QByteArray src = native(from);
+    const QByteArray dst = native(to);
+    struct stat rootStat;
+    if (::lstat(src.constData(), &rootStat) != 0) {
+        result.error = errno;
+        return result;
+    }
+    if (!S_ISDIR(rootStat.st_mode)) {
+        result.error = ENOTDIR;
+        return result;
+    }
+    // Owner-only until the copy is complete; real modes are set at the end
+    if (::mkdir(dst.constData(), 0700) != 0) {
+        result.error = errno;
+        return result;
+    }
+
+    std::atomic<int> firstError{0};
+    auto fail = [&firstError](int error) {
+        int none = 0;
+        firstError.compare_exchange_strong(none, error);
+    };
+    std::atomic<int> files{0};
+    std::atomic<int> links{0};
+    std::atomic<qint64> bytes{0};
+
+    QMutex mutex;
+    QVector<Dir> dirs = {{QByteArray(), rootStat}};  // breadth-first
+    QVector<QByteArray> leaves;                      // files and links
+    QThreadPool walkers;
+    walkers.setMaxThreadCount(this->maxThreads);
+    QThreadPool copiers;
+    copiers.setMaxThreadCount(this->maxThreads);
+
+    // One level at a time: list every directory of the level in parallel,
+    // creating its subdirectories and queueing its files as they turn up
+    qsizetype levelStart = 0;
+    while (levelStart < dirs.size() && firstError == 0) {
+        // Taken before the walkers start appending the next level
+        const QVector<Dir> level = dirs.mid(levelStart);
+        levelStart = dirs.size();
+        for (const Dir& dir : level) {
+            const QByteArray rel = dir.rel;
+            walkers.start([&, rel]() {
+                if (firstError != 0)
+                    return;
+                DIR* handle = ::opendir((src + rel).constData());
+                if (!handle) {
+                    fail(errno);
+                    return;
+                }
+                const int fd = ::dirfd(handle);
+                QVector<Dir> subdirs;
+                QVector<QByteArray> found;
+                while (const dirent* d = ::readdir(handle)) {
+                    if (qstrcmp(d->d_name, ".") == 0 ||
+                        qstrcmp(d->d_name, "..") == 0)
+                        continue;
+                    const QByteArray child = rel + '/' + d->d_name;
+                    struct stat st;
+                    if (::fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
+                        fail(errno);
+                        break;
+                    }
+                    if (S_ISDIR(st.st_mode)) {
+                        if (::mkdir((dst + child).constData(), 0700) != 0) {
+                            fail(errno);
+                            break;
+                        }
+                        subdirs.append({child, st});
+                    } else if (S_ISREG(st.st_mode)) {
+                        found.append(child);
+                        copiers.start([&, child, st]() {
+                            if (firstError != 0)
+                                return;
+                            if (const int error =
+                                    copyFile(src + child, dst + child, st)) {
+                                fail(error);
+                                return;
+                            }
+                            files++;
+                            bytes += st.st_size;
+                        });
+                    } else if (S_ISLNK(st.st_mode)) {
+                        found.append(child);
+                        if (const int error =
+                                copyLink(src + child, dst + child, st)) {
+                            fail(error);
+                            break;
+                        }
+                        links++;
+                    } else {
+                        // Devices, fifos, sockets: refuse rather than move a
+                        // tree that would come out incomplete
+                        fail(EOPNOTSUPP);
+                        break;
+                    }
+                }
+                ::closedir(handle);
+                QMutexLocker lock(&mutex);
+                dirs.append(subdirs);
+                leaves.append(found);
+            });
+        }
+        walkers.waitForDone();
+    }
+    copiers.waitForDone();
+
+    // Unlink the leaves in parallel, then the directories deepest first
+    auto removeTree = [&](const QByteArray& base) {
+        for (qsizetype start = 0; start < leaves.size();
+             start += unlinkBatchSize) {
+            copiers.start([&, start]() {
+                const qsizetype end =
+                    std::min(start + unlinkBatchSize, leaves.size());
+                for (qsizetype i = start; i < end; ++i)
+                    ::unlink((base + leaves[i]).constData());
+            });
+        }
+        copiers.waitForDone();
+        for (qsizetype i = dirs.size() - 1; i >= 0; --i)
+            ::rmdir((base + dirs[i].rel).constData());
+    };
+
+    result.error = firstError;
+    if (result.error == 0 && files + links != leaves.size())
+        result.error = EIO;
+    if (result.error != 0) {
+        removeTree(dst);
+        return result;
+    }
+
+    // Directory modes and times last: creating entries changed the times,
+    // and a read-only mode would have stopped the copy
+    for (qsizetype i = dirs.size() - 1; i >= 0; --i) {
+        const QByteArray path = dst + dirs[i].rel;
+        struct timespec times[2];
+        timesOf(dirs[i].st, times);
+        ::chmod(path.constData(), dirs[i].st.st_mode & 07777);
+        ::utimensat(AT_FDCWD, path.constData(), times, 0);
+    }
+
+    removeTree(src);
+    if (::access(src.constData(), F_OK) == 0)
+        qWarning() << "Moved" << from << "to" << to
+                   << "but could not remove all of the original";
+
+    result.files = files;
+    result.directories = dirs.size();
+    result.links = links;
+    result.bytes = bytes;
+#else
+    namespace fs = std::filesystem;
+    const fs::path source(from.toStdWString());
+    const fs::path target(to.toStdWString());
+    std::error_code ec;
+    if (fs::exists(target, ec)) {
+        result.error = EEXIST;
+        return result;
+    }
+    fs::copy(source, target,
+             fs::copy_options::recursive | fs::copy_options::copy_symlinks,
+             ec);
+    if (ec) {
+        fs::remove_all(target, ec);
+        result.error = EIO;
+        return result;
+    }
+    fs::remove_all(source, ec);
+#endif
+    return result;
+}
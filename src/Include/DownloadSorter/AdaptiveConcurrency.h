@@ -0,0 +1,46 @@
+#ifndef ADAPTIVECONCURRENCY_H
+#define ADAPTIVECONCURRENCY_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+// AIMD limit on how many operations run at once against one device. Every
+// window of completed operations is compared with the one before: while
+// throughput keeps up and the cost per unit (byte or operation) stays near
+// the best seen, the limit grows by one; once throughput falls or the cost
+// climbs, which is what queueing inside a saturated device looks like, it
+// is halved. A USB stick thus settles at one or two operations in flight
+// and an NVMe drive at dozens.
+class AdaptiveConcurrency {
+   public:
+    AdaptiveConcurrency(int initial, int minimum, int maximum);
+
+    // Blocks while limit() operations are already running
+    void acquire();
+    // Ends an acquire(); `units` (bytes copied, or 1 per rename) done in
+    // `nanoseconds` feed the controller, 0 units leave it alone
+    void release(qint64 nanoseconds, qint64 units);
+
+    int limit() const;
+    int maximum() const { return this->ceiling; }
+
+   private:
+    mutable QMutex mutex;
+    QWaitCondition slotFree;
+    int current;
+    int floor;
+    int ceiling;
+    int running = 0;
+
+    QElapsedTimer window;
+    int windowOps = 0;
+    qint64 windowUnits = 0;
+    qint64 windowNs = 0;
+    double lastThroughput = 0;  // units per ns
+    double bestCost = 0;        // ns per unit
+
+    void adjust();
+};
+
+#endif  // ADAPTIVECONCURRENCY_H
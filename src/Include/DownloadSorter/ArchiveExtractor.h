@@ -0,0 +1,37 @@
+#ifndef ARCHIVEEXTRACTOR_H
+#define ARCHIVEEXTRACTOR_H
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include <functional>
+
+// Unpacks archives into a folder next to each one ("x.zip" -> "x/"). ZIP
+// entries are inflated in parallel, each streamed straight from the archive
+// into its file; other formats (and ZIPs this reader cannot handle) go to
+// 7-Zip or bsdtar when one is installed, one process per archive. Archives
+// and entries share one bounded pool, and nothing is unpacked unless the
+// volume has room for it.
+class ArchiveExtractor {
+   public:
+    struct Result {
+        int extracted = 0;  // archives
+        int skipped = 0;    // no room, no tool for the format
+        int failed = 0;
+        qint64 bytesWritten = 0;  // by the built-in ZIP reader
+    };
+
+    explicit ArchiveExtractor(int maxThreads);
+
+    // Suffixes extract() picks up
+    static bool isArchive(const QString& path);
+
+    // `cancelled` is polled before each entry
+    Result extract(const QStringList& archives,
+                   const std::function<bool()>& cancelled = {}) const;
+
+   private:
+    int maxThreads;
+};
+
+#endif  // ARCHIVEEXTRACTOR_H
@@ -0,0 +1,53 @@
+#ifndef CHANGEPROBE_H
+#define CHANGEPROBE_H
+
+#include <QtCore/QString>
+
+// Cheap "has this folder changed?" check for mounts where change
+// notifications never arrive (NFS, SMB). One statx() of the folder compares
+// its mtime, ctime, size and link count; the size and link count move with
+// the number of entries on most filesystems. Optionally a digest of the
+// entry names is added, which costs a readdir (no per-entry stat) but also
+// catches changes inside the mtime granularity of the server.
+//
+// The poll interval backs off while the folder stays quiet and drops back
+// to the minimum as soon as something changes.
+class ChangeProbe {
+   public:
+    ChangeProbe(const QString& root,
+                bool digestNames = false,
+                int minIntervalMs = 2000,
+                int maxIntervalMs = 5 * 60 * 1000);
+
+    // True on the first call and whenever the folder differs from the last
+    // state that was reported
+    bool changed();
+
+    // Wait this long before the next changed()
+    int intervalMs() const { return this->interval; }
+
+   private:
+    struct Signature {
+        qint64 mtimeNs = -1;
+        qint64 ctimeNs = -1;
+        qint64 size = -1;
+        qint64 links = -1;
+        qint64 entries = -1;  // with digestNames only
+        quint64 names = 0;    // order-independent hash of the entry names
+        bool exists = false;
+
+        bool operator==(const Signature& other) const;
+    };
+
+    QString root;
+    bool digestNames;
+    int minInterval;
+    int maxInterval;
+    int interval;
+    bool primed = false;
+    Signature last;
+
+    Signature read() const;
+};
+
+#endif  // CHANGEPROBE_H
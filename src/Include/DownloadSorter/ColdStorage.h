@@ -0,0 +1,54 @@
+#ifndef COLDSTORAGE_H
+#define COLDSTORAGE_H
+
+#include <QtCore/QDir>
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+// Compresses files that have not been touched for a while into pack files
+// kept in a hidden ".coldstore" folder inside a category folder. Each pack is
+// written by a single worker, and a binary index maps the original relative
+// path to its location so any file can be restored on demand.
+class ColdStorage {
+   public:
+    struct Entry {
+        QString pack;
+        qint64 offset = 0;
+        qint64 size = 0;
+        qint64 storedSize = 0;
+        qint64 mtime = 0;  // msecs since epoch
+    };
+
+    struct Result {
+        int archived = 0;
+        int failed = 0;
+        qint64 bytesIn = 0;
+        qint64 bytesOut = 0;
+    };
+
+    static constexpr const char* storeDirName = ".coldstore";
+
+    explicit ColdStorage(const QString& categoryPath);
+
+    // Compress every file older than `days` (by last access/modification)
+    // using at most `maxThreads` low-priority workers
+    Result archiveOlderThan(int days, int maxThreads);
+
+    // Relative paths of everything currently held in cold storage
+    QStringList entries() const { return this->index.keys(); }
+
+    // Write a file back to its original location and drop it from the index
+    bool restore(const QString& relativePath, QString* error = nullptr);
+
+   private:
+    QDir categoryDir;
+    QDir storeDir;
+    QHash<QString, Entry> index;
+
+    bool loadIndex();
+    bool saveIndex() const;
+    QStringList collectCandidates(int days) const;
+};
+
+#endif  // COLDSTORAGE_H
@@ -0,0 +1,13 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+// Headless entry points. These run on a QCoreApplication so scripted runs and
+// the resident service never load the widget stack.
+namespace CommandLine {
+// True if argv asks for a headless mode (--service, --sort, ...)
+bool isHeadless(int argc, char* argv[]);
+
+int run(int argc, char* argv[]);
+}  // namespace CommandLine
+
+#endif  // COMMANDLINE_H
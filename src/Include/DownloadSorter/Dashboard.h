@@ -9,7 +9,9 @@
 #include <QtWidgets/QLineEdit>
 #include <QtWidgets/QPushButton>
 // #include <QtWidgets/QSpacerItem>
+#include <QtCore/QMutex>
 #include <QtCore/QSettings>
+#include <QtCore/QThreadPool>
 #include <QtWidgets/QMainWindow>
 
 #include <QtWidgets/QStatusBar>
@@ -19,10 +21,17 @@
 // New UI pieces for menu and progress bar
 #include <QtWidgets/QProgressBar>
 class QAction;
+class QListWidget;
 class QMenu;
 
 #include "subclass.h"
 
+class FilenameIndex;
+class SortClient;
+
+#include <atomic>
+#include <memory>
+
 // #include <boost/format.hpp>
 
 #include <QtCore/QCoreApplication>
@@ -38,13 +47,20 @@ class Dashboard : public QMainWindow {
    private:
     QString currentDownloadFolder = QString("E:/Downloads");
 
-    QLineEdit* pathField = new QLineEdit();
-    QSettings* settings = new QSettings(QSettings::NativeFormat,
-                                        QSettings::UserScope,
-                                        "Yangkie",
-                                        "Download Sorter");
+    QLineEdit* pathField = nullptr;
+
+    // Connection to the resident sort service, when one is running
+    SortClient* sortClient = nullptr;
+    // A sort handed to the service has not finished yet
+    bool serviceSortRunning = false;
+    // A service was launched and is being waited for
+    bool awaitingService = false;
 
     void initiateSort();
+    // Fallback when no service can be reached
+    void sortInProcess();
+    void sortThroughService();
+    void serviceLost();
     void downloadFinished();
 
     // Menu action and a status-bar progress bar
@@ -52,16 +68,44 @@ class Dashboard : public QMainWindow {
     QAction* configureRulesAction = nullptr;
     QProgressBar* progressBar = nullptr;
 
+    // Per-category numbers read from the persisted statistics index
+    QLabel* statsLabel = nullptr;
+
+    // Filename search over the sorted category folders
+    QLineEdit* searchField = nullptr;
+    QListWidget* searchResults = nullptr;
+    std::shared_ptr<FilenameIndex> searchIndex;
+    // Guards the index's contents while the background pool updates them
+    QMutex searchMutex;
+    // Serializes snapshot writes; a write for an index that has since been
+    // rebuilt (older generation) is dropped
+    QMutex snapshotMutex;
+    std::atomic<int> indexGeneration{0};
+    // Index builds and snapshot writes; drained before the window goes away
+    QThreadPool backgroundPool;
+
     // Help menu
     QMenu* helpMenu = nullptr;
     QAction* checkUpdatesAction = nullptr;
     QAction* aboutAction = nullptr;
 
+    // Tools menu
+    QMenu* toolsMenu = nullptr;
+    QAction* restoreColdAction = nullptr;
+    QAction* retentionSweepAction = nullptr;
+
     // Helpers
+    void finishStartup();
     void onSortStarted();
     void openRulesConfigurator();
     void checkForUpdates();
     void showAbout();
+    void restoreFromColdStorage();
+    void sweepRetention();
+    void refreshStorageStats();
+    void buildSearchIndex(bool rescan = false);
+    void runSearch(const QString& query);
+    void indexMovedContents(const QMap<QString, QString>& moved);
 
    public slots:
     void browseDownloadFolder();
@@ -5,9 +5,12 @@
 #include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
+#include <QtCore/QHash>
 #include <QtCore/QList>
 #include <QtCore/QMap>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
+#include <QtCore/QPair>
 #include <QtCore/QRegularExpression>
 #include <QtCore/QString>
 #include <QtCore/QStringList>
@@ -19,15 +22,72 @@
 // #include "fmt/format.h"
 // #include "fmt/format-inl.h"
 
+#include <functional>
 #include <iostream>
 #include <string>
 
-#include <filesystem>
+#include <memory>
+
+#include "ArchiveExtractor.h"
+#include "FileSystem.h"
+#include "LinkView.h"
+#include "Resharder.h"
+#include "RetentionSweeper.h"
+#include "RuleSet.h"
+#include "StorageStats.h"
+
+// What happens to a folder with the same content as one already in
+// Downloaded Folders (instead of a name clash, a re-extracted archive).
+// Anything but Rename needs the real disk; with another FileSystem backend
+// every folder is sorted as Rename would.
+enum class DuplicateFolders {
+    Rename,  // sorted as "name (n)", like any other clash
+    Skip,    // left where it is
+    Remove,  // deleted
+    Link,    // sorted as "name (n)" with its files hardlinked to the first
+};
 
 // Unified settings struct
 struct SettingsData {
     QMap<QString, QList<QString>> mappings;
     QList<QString> ignorePatterns;
+    // Compress files untouched for this many days (0 disables cold storage)
+    int coldStorageAgeDays = 0;
+    // Per-category cleanup limits, keyed by category folder name
+    QMap<QString, RetentionRule> retention;
+    // Link into a separate view tree instead of moving anything
+    bool viewMode = false;
+    QString viewFolder;  // empty: LinkView::defaultRoot()
+    // Category folder name -> directory to create it in (default: the
+    // download folder)
+    QMap<QString, QString> destinationRoots;
+    // Copy to other drives in on-disk order of the sources (spinning disks)
+    bool layoutOrderedCopies = false;
+    // Unpack archives next to themselves once sorted into Downloaded
+    // Archives
+    bool extractArchives = false;
+    // Category folder name -> subfolder layout (default: flat)
+    QMap<QString, ShardLayout> shardLayouts;
+    DuplicateFolders duplicateFolders = DuplicateFolders::Rename;
+};
+
+// The sorter's signals as plain callbacks, for code that drives a sort
+// without an event loop (batch runs, benchmarks, tests). Every member is
+// optional. They are called on the sorting thread, except:
+//  - `progress`, which the move workers call too, one at a time (under the
+//    sorter's move lock) and with values that never go backwards; keep it
+//    short, since the other workers wait for it;
+//  - `cancelled`, which the move workers poll concurrently, so it must be
+//    safe to call from several threads at once.
+struct SortCallbacks {
+    std::function<void(int minimum, int maximum)> progressRange;
+    std::function<void(int value)> progress;
+    std::function<void(const QString& message)> status;
+    std::function<void(const QMap<QString, QString>& plan)> planReady;
+    std::function<void(const QMap<QString, QString>& moved)> contentsMoved;
+    std::function<void()> categoriesChanged;
+    // Polled between items; true stops the sort like requestInterruption()
+    std::function<bool()> cancelled;
 };
 
 class DownloadSorter : public QThread {
@@ -37,7 +97,19 @@ class DownloadSorter : public QThread {
     // Accept const reference to QString for flexibility
     DownloadSorter(const QString& path);
 
+    // Also callable directly, without start(), to sort on the calling
+    // thread; progress then arrives through setCallbacks()
     void run();
+    // False once run() has left planned items where they were (failed
+    // moves, or ones a cancel never got to) or was interrupted
+    bool completed() const {
+        return this->unmoved == 0 && !this->stopRequested();
+    }
+
+    // Report progress to these as well as through the signals
+    void setCallbacks(const SortCallbacks& callbacks) {
+        this->callbacks = callbacks;
+    }
 
     // Add: configure mappings at runtime
     void setFileTypesMap(const QMap<QString, QList<QString>>& map) {
@@ -49,16 +121,83 @@ class DownloadSorter : public QThread {
 
     // New: accept ignore patterns (regex strings), compile and store
     void setIgnorePatterns(const QList<QString>& patterns) {
-        ignorePatterns.clear();
+        ignorePatterns = compileIgnorePatterns(patterns);
+    }
+
+    // Reuse regexes compiled earlier (e.g. cached by the sort service)
+    void setIgnoreExpressions(const QList<QRegularExpression>& expressions) {
+        ignorePatterns = expressions;
+    }
+
+    static QList<QRegularExpression> compileIgnorePatterns(
+        const QList<QString>& patterns) {
+        QList<QRegularExpression> compiled;
         for (const QString& p : patterns) {
             const QString trimmed = p.trimmed();
             if (trimmed.isEmpty())
                 continue;
             QRegularExpression re(trimmed);
             if (re.isValid())
-                ignorePatterns.append(re);
+                compiled.append(re);
             // invalid regexes are skipped silently; could log if needed
         }
+        return compiled;
+    }
+
+    // Plan only: report what would move through planReady without touching
+    // the disk
+    void setDryRun(bool enabled) { dryRun = enabled; }
+
+    // Post-sort stage: compress files in the category folders that have not
+    // been touched for `days` days (0 disables it)
+    void setColdStorageAgeDays(int days) { coldStorageAgeDays = days; }
+
+    // Post-sort stage: delete what the per-category retention rules no
+    // longer allow (a dry run only counts it)
+    void setRetentionRules(const QMap<QString, RetentionRule>& rules) {
+        retentionRules = rules;
+    }
+
+    // Build the category layout as links under `viewFolder` (or the default
+    // view next to the download folder) and leave every source in place
+    void setViewMode(bool enabled, const QString& viewFolder = QString()) {
+        viewMode = enabled;
+        viewRoot = viewFolder;
+    }
+
+    // Create these categories under their own root (e.g. on another disk)
+    // instead of inside the download folder
+    void setDestinationRoots(const QMap<QString, QString>& roots) {
+        destinationRoots = roots;
+    }
+
+    // Place new entries of these categories in shard subfolders
+    // ("2024/05/", "a3/") instead of directly in the category folder
+    void setShardLayouts(const QMap<QString, ShardLayout>& layouts) {
+        shardLayouts = layouts;
+    }
+
+    // Order each cross-device copy queue by where the sources sit on disk
+    // and read ahead of the copy, instead of going in path order
+    void setLayoutOrderedCopies(bool enabled) {
+        layoutOrderedCopies = enabled;
+    }
+
+    // Look for an identical folder among the ones a directory's name clashes
+    // with, and skip, delete or link it instead of adding "name (n)"
+    void setDuplicateFolders(DuplicateFolders action) {
+        duplicateFolders = action;
+    }
+
+    // Post-move stage: unpack archives that were just sorted into
+    // "Downloaded Archives" into sibling folders (the archives are kept)
+    void setExtractArchives(bool enabled) { extractSortedArchives = enabled; }
+
+    // Plan and move through `fileSystem` instead of the real disk (archive
+    // extraction, cold storage, retention, storage stats, view mode and
+    // duplicate detection always use the disk)
+    void setFileSystem(std::shared_ptr<FileSystem> fileSystem) {
+        fs = std::move(fileSystem);
     }
 
     // Optional helper used by sorter code to check whether a name should be
@@ -71,20 +210,42 @@ class DownloadSorter : public QThread {
         return false;
     }
 
+    // Built-in category folders plus every folder named by a mapping
+    static QList<QString> managedFolders(
+        const QMap<QString, QList<QString>>& mappings);
+
+    // Absolute path of a category folder given the per-category roots
+    static QString categoryPath(const QString& root,
+                                const QString& category,
+                                const QMap<QString, QString>& destinationRoots);
+    // Whether one of two paths is, or lies inside, the other
+    static bool pathsOverlap(const QString& a, const QString& b);
+    // categoryPath() of every managedFolders() entry
+    static QStringList categoryPaths(
+        const QString& root,
+        const QMap<QString, QList<QString>>& mappings,
+        const QMap<QString, QString>& destinationRoots);
+
    signals:
     // Progress bar and status signals
     void progressRangeChanged(int minimum, int maximum);
     void progressValueChanged(int value);
     void statusMessage(const QString& message);
+    // Emitted instead of moving anything when running as a dry run
+    void planReady(const QMap<QString, QString>& plan);
+    // Everything moveContents actually moved (source -> destination)
+    void contentsMoved(const QMap<QString, QString>& moved);
+    // Once per sort, if archive extraction, cold storage or retention added
+    // or removed entries in the category folders (moves are reported by
+    // contentsMoved)
+    void categoriesChanged();
 
    private:
     QDir downloadFolder;
-    QList<QFileInfo> contents;
+    QVector<FileSystem::Entry> contents;
+    std::shared_ptr<FileSystem> fs = FileSystem::local();
 
-    QList<QString> blacklist = {"Downloaded Archives",  "Downloaded Audios",
-                                "Downloaded Documents", "Downloaded Fonts",
-                                "Downloaded Images",    "Downloaded Programs",
-                                "Downloaded Videos",    "Downloaded Folders"};
+    static inline const QList<QString>& blacklist = RuleSet::builtinFolders;
 
     QMap<QString, QList<QString>> fileTypesMap;
     // QMap<QFileInfo, QString> filesPerCategory;
@@ -92,12 +253,82 @@ class DownloadSorter : public QThread {
     // added member to store compiled ignore regexes
     QList<QRegularExpression> ignorePatterns;
 
+    int coldStorageAgeDays = 0;
+    QMap<QString, RetentionRule> retentionRules;
+    bool dryRun = false;
+    bool viewMode = false;
+    QString viewRoot;
+    QMap<QString, QString> destinationRoots;
+    bool layoutOrderedCopies = false;
+    bool extractSortedArchives = false;
+    QMap<QString, ShardLayout> shardLayouts;
+    DuplicateFolders duplicateFolders = DuplicateFolders::Rename;
+    // Destination folder -> category, for every folder in the plan
+    QHash<QString, QString> categoryByFolder;
+    // Duplicate folders found by the plan: those to delete, and source ->
+    // identical sorted folder for those to link
+    QStringList duplicateSources;
+    QHash<QString, QString> linkSources;
+    // A post-sort stage changed the category folders
+    bool categoriesTouched = false;
+    // Planned items the last moveContents did not move
+    int unmoved = 0;
+
+    // Per-category counts kept current as a side effect of moving
+    StorageStats stats;
+    // Directories renamed into a category, recorded once they are sized
+    struct MovedFolder {
+        QString category;
+        QString path;
+        QDateTime modified;
+    };
+    QVector<MovedFolder> unsizedFolders;
+    // Guards stats, unsizedFolders and the moved map while device queues
+    // run in parallel, and serializes the workers' progress reports
+    QMutex moveMutex;
+    SortCallbacks callbacks;
+
+    // Emit a signal and call the matching callback
+    void reportRange(int minimum, int maximum);
+    void reportProgress(int value);
+    void reportStatus(const QString& message);
+    void reportPlan(const QMap<QString, QString>& plan);
+    void reportMoved(const QMap<QString, QString>& moved);
+    void reportCategoriesChanged();
+    // requestInterruption() or the cancelled callback
+    bool stopRequested() const;
+
     void recalculateContents();
     QMap<QString, QString> evaluateCategory();
-    int moveContents(QMap<QString, QString> contents);
-    QString suffixToFolder(QFileInfo content);
+    // Source -> destination
+    using MoveJob = QPair<QString, QString>;
+
+    // Returns what was actually moved
+    QMap<QString, QString> moveContents(QMap<QString, QString> contents);
+    // Bytes moved, or -1 if the move failed
+    qint64 moveOne(const QString& src, const QString& dst);
+    void orderByLayout(QList<MoveJob>& jobs) const;
+    // Whether `path` is, or holds, one of `categories` (a destination root
+    // inside the download folder); sorting it would move the category into
+    // Downloaded Folders
+    static bool holdsCategory(const QString& path,
+                              const QStringList& categories);
+    QString categoryPath(const QString& category) const {
+        return categoryPath(downloadFolder.absolutePath(), category,
+                            destinationRoots);
+    }
 
     void createFoldersIfDoesntExist();
+    void updateLinkView();
+    void extractArchives(const QMap<QString, QString>& moved);
+    void removeDuplicateFolders();
+    // Duplicate detection hashes and hardlinks trees on the real disk
+    // directly (TreeHasher), so it only runs when that is the backend
+    bool onRealDisk() const;
+    void archiveColdFiles();
+    void applyRetention();
+    void updateStorageStats();
+    void recordMovedFolders();
 };
 
 #endif  // DOWNLOADSORTER_H
\ No newline at end of file
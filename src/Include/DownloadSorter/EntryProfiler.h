@@ -0,0 +1,67 @@
+#ifndef ENTRYPROFILER_H
+#define ENTRYPROFILER_H
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+#include <memory>
+
+#include "FileSystem.h"
+#include "RuleSet.h"
+
+// Profiles what a sort would leave behind: the files at the top of one or
+// more download folders that no mapping claims. They are counted and sized
+// by suffix, by leading name word ("IMG", "Screenshot") and by the family
+// their first bytes identify ("pdf", "zip", "elf"), and suffixes whose
+// files are almost all of one known family are suggested as new mappings.
+// Roots are listed in parallel and the entries classified in chunks across
+// a pool, each chunk tallying on its own, so a single pass stays fast even
+// for millions of entries.
+class EntryProfiler {
+   public:
+    struct Row {
+        QString key;  // "" for files without a suffix
+        qint64 count = 0;
+        qint64 bytes = 0;
+    };
+
+    // Mapping `suffix` to `folder` would move `count` files (`bytes`)
+    struct Suggestion {
+        QString suffix;
+        QString folder;
+        qint64 count = 0;
+        qint64 bytes = 0;
+    };
+
+    struct Report {
+        qint64 entries = 0;  // everything listed
+        qint64 ignored = 0;  // left in place by an ignore pattern
+        qint64 unmatched = 0;
+        qint64 unmatchedBytes = 0;
+        // All largest (by bytes) first
+        QVector<Row> suffixes;
+        QVector<Row> prefixes;
+        QVector<Row> families;
+        QVector<Suggestion> suggestions;
+    };
+
+    // Lists and sizes through `fileSystem`; the first bytes of each file
+    // are always read from the disk
+    explicit EntryProfiler(
+        const RuleSet& rules,
+        std::shared_ptr<FileSystem> fileSystem = FileSystem::local());
+
+    Report profile(const QStringList& roots, int maxThreads) const;
+
+    // Family of a file from its first bytes ("pdf", "zip", "text", "data"
+    // when nothing matches) and the category folder it belongs in ("" if
+    // none fits)
+    static QString family(const QByteArray& head, QString* folder = nullptr);
+
+   private:
+    RuleSet rules;
+    std::shared_ptr<FileSystem> fs;
+};
+
+#endif  // ENTRYPROFILER_H
@@ -0,0 +1,95 @@
+#ifndef FILESYSTEM_H
+#define FILESYSTEM_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <memory>
+
+// The filesystem operations a sort needs, so the planner and the move
+// scheduler can run against something other than the real disk. Paths are
+// absolute with '/' separators. Mutating calls return 0 or an errno value
+// (EXDEV, ENOSPC, EACCES, ...) so callers can react to the actual failure.
+class FileSystem {
+   public:
+    struct Entry {
+        QString name;
+        bool isDir = false;
+        qint64 size = 0;     // filled by stat() only
+        QDateTime modified;  // filled by stat() only
+    };
+
+    virtual ~FileSystem() = default;
+
+    // Visible entries directly inside `dir` (no hidden files, no dangling
+    // links), names and types only
+    virtual QVector<Entry> list(const QString& dir) const = 0;
+    // False if nothing is at `path`; `entry` may be null
+    virtual bool stat(const QString& path, Entry* entry) const = 0;
+    bool exists(const QString& path) const {
+        return this->stat(path, nullptr);
+    }
+    // First of "name", "name (1)", ... that is free in `folder`; files are
+    // numbered before the suffix ("base (1).ext")
+    QString freePath(const QString& folder,
+                     const QString& name,
+                     bool isDir) const;
+    // Size of a file, or of everything below a directory
+    virtual qint64 totalSize(const QString& path) const = 0;
+    // Same value for two paths means a rename between them is cheap
+    virtual QByteArray device(const QString& path) const = 0;
+    // Where a file's data starts on its device, or anything that sorts
+    // roughly the same way (0 if unknown); used to read in disk order
+    virtual quint64 physicalOffset(const QString& path) const {
+        Q_UNUSED(path);
+        return 0;
+    }
+    // Hint that `path` is about to be read in full
+    virtual void willRead(const QString& path) const { Q_UNUSED(path); }
+
+    virtual int mkpath(const QString& path) = 0;
+    // Never replaces an existing `to` (EEXIST)
+    virtual int rename(const QString& from, const QString& to) = 0;
+    // Files only; keeps the modification time
+    virtual int copy(const QString& from, const QString& to) = 0;
+    // A file or an empty directory
+    virtual int remove(const QString& path) = 0;
+    // Directory counterpart of copy() then remove(), for moves across
+    // devices: `from` is deleted only once all of it has been copied, and a
+    // failed copy is deleted again. This default goes through the calls
+    // above one entry at a time.
+    virtual int moveTree(const QString& from, const QString& to);
+    // A file, or a directory and everything below it. Keeps going past
+    // entries it cannot remove and returns the first error; this default
+    // goes through list() and remove().
+    virtual int removeTree(const QString& path);
+
+    // Shared instance for the real disk
+    static std::shared_ptr<FileSystem> local();
+};
+
+// The real disk through POSIX calls (Qt on Windows)
+class PosixFileSystem : public FileSystem {
+   public:
+    QVector<Entry> list(const QString& dir) const override;
+    bool stat(const QString& path, Entry* entry) const override;
+    qint64 totalSize(const QString& path) const override;
+    QByteArray device(const QString& path) const override;
+    // First FIEMAP extent on Linux, the inode number elsewhere
+    quint64 physicalOffset(const QString& path) const override;
+    // posix_fadvise(WILLNEED) where available
+    void willRead(const QString& path) const override;
+
+    int mkpath(const QString& path) override;
+    int rename(const QString& from, const QString& to) override;
+    int copy(const QString& from, const QString& to) override;
+    int remove(const QString& path) override;
+    // TreeTransfer: parallel copy keeping modes, times and symlinks
+    int moveTree(const QString& from, const QString& to) override;
+    // Hidden entries included, which list() leaves out
+    int removeTree(const QString& path) override;
+};
+
+#endif  // FILESYSTEM_H
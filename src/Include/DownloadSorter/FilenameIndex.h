@@ -0,0 +1,58 @@
+#ifndef FILENAMEINDEX_H
+#define FILENAMEINDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include <array>
+#include <vector>
+
+// Substring search over file names through a trigram index. Every lowercased
+// name is split into overlapping three-character keys, each mapping to the
+// sorted ids of the names that contain it; a query only has to intersect the
+// lists of its own trigrams and confirm the few survivors.
+class FilenameIndex {
+   public:
+    // Replace the contents with `paths`, splitting the work across cores
+    void build(const QStringList& paths);
+
+    void add(const QString& path);
+    void remove(const QString& path);
+
+    // Case-insensitive substring match on the file name part of each path
+    QStringList search(const QString& query, int limit = 200) const;
+
+    qsizetype size() const { return this->ids.size(); }
+    QStringList allPaths() const;
+
+    // Snapshot of the indexed paths so the next start can skip the walk
+    static QStringList loadSnapshot(const QString& root);
+    static bool saveSnapshot(const QString& root, const QStringList& paths);
+    // Whether the snapshot still describes `categoryFolders`: it is not
+    // older than any of them, and no sort has invalidated it since
+    static bool snapshotIsFresh(const QString& root,
+                                const QStringList& categoryFolders);
+    // Called by whatever changes the category folders (in any process), so
+    // the next index build walks them again
+    static void invalidateSnapshot(const QString& root);
+
+    // Walk the category folders in parallel and list everything below them
+    static QStringList scan(const QStringList& categoryFolders);
+
+   private:
+    // Postings are split into shards by trigram so they can be built in
+    // parallel without locking
+    static constexpr int shardCount = 16;
+    using Postings = QHash<quint64, std::vector<quint32>>;
+
+    QStringList paths;                // id -> path, empty once removed
+    std::vector<QString> lowerNames;  // id -> lowercased file name
+    QHash<QString, quint32> ids;
+    std::array<Postings, shardCount> shards;
+
+    static QString snapshotPath(const QString& root);
+};
+
+#endif  // FILENAMEINDEX_H
@@ -0,0 +1,54 @@
+#ifndef LINKVIEW_H
+#define LINKVIEW_H
+
+#include <QtCore/QDir>
+#include <QtCore/QMap>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+// A categorized view of a download folder made of links instead of moves.
+// Files are hardlinked into "<view>/<category>/" when they share a device
+// with the view and symlinked otherwise; directories are always symlinked.
+// Sources never move, and each sync only creates what is missing and
+// removes links whose source is gone or has been replaced.
+//
+// Every link a sync creates is recorded in a manifest kept in the view root,
+// one per download folder, and nothing else is ever removed: files saved
+// into the view by hand and links made for another download folder sharing
+// the view are left alone. A recorded hardlink that has become the last
+// name of its file (the download was deleted) is kept as well.
+class LinkView {
+   public:
+    struct Result {
+        int hardlinked = 0;
+        int symlinked = 0;
+        int unchanged = 0;
+        int removed = 0;
+        int kept = 0;  // stale, but not the view's to remove
+        int failed = 0;
+    };
+
+    // The view of `sourceRoot` (a download folder) in `viewRoot`
+    LinkView(const QString& viewRoot, const QString& sourceRoot);
+
+    // Bring the view in line with `links` (view path -> source path)
+    Result sync(const QMap<QString, QString>& links);
+
+    // "<download folder> View", next to the download folder so a sort never
+    // sees the view as an entry to categorize
+    static QString defaultRoot(const QString& downloadRoot);
+
+   private:
+    QDir root;
+    QString manifestPath;
+
+    // View paths (relative to the root) this download folder's syncs created
+    QSet<QString> loadManifest() const;
+    bool saveManifest(const QSet<QString>& created) const;
+
+    static bool isCurrent(const QString& viewPath, const QString& source);
+    static bool link(const QString& source, const QString& viewPath,
+                     Result& result);
+};
+
+#endif  // LINKVIEW_H
@@ -0,0 +1,103 @@
+#ifndef MEMORYFILESYSTEM_H
+#define MEMORYFILESYSTEM_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+
+#include <array>
+
+#include "FileSystem.h"
+
+// A filesystem held entirely in memory, for exercising the sorter without a
+// disk: millions of synthetic entries plan in seconds, mount points give
+// separate devices (so cross-device moves fail with EXDEV and copies can run
+// out of space), and any operation can be slowed down or made to fail.
+// Safe to use from several threads. Only planning and moving go through it:
+// the post-sort stages (archive extraction, cold storage, retention, storage
+// stats) and duplicate detection still work on the real disk.
+class MemoryFileSystem : public FileSystem {
+   public:
+    enum class Op { List, Stat, Mkpath, Rename, Copy, Remove };
+
+    MemoryFileSystem();
+
+    // Parents are created as needed
+    void addFile(const QString& path,
+                 qint64 size,
+                 const QDateTime& modified = QDateTime::currentDateTime());
+    void addDirectory(const QString& path);
+
+    // Everything below `mountPoint` lives on its own device holding at most
+    // `capacity` bytes (< 0: unlimited)
+    void mount(const QString& mountPoint, qint64 capacity = -1);
+
+    // Every call of `op` sleeps this long first
+    void setLatency(Op op, int microseconds);
+    // Make `op` on paths below `prefix` fail with `error` (an errno value),
+    // `count` times or, if negative, until cleared
+    void injectError(Op op, const QString& prefix, int error, int count = -1);
+    void clearErrors();
+
+    // Calls of `op` so far, failed ones included
+    qint64 callCount(Op op) const;
+
+    QVector<Entry> list(const QString& dir) const override;
+    bool stat(const QString& path, Entry* entry) const override;
+    qint64 totalSize(const QString& path) const override;
+    QByteArray device(const QString& path) const override;
+    // Creation order, like inode numbers on a fresh filesystem
+    quint64 physicalOffset(const QString& path) const override;
+
+    int mkpath(const QString& path) override;
+    int rename(const QString& from, const QString& to) override;
+    int copy(const QString& from, const QString& to) override;
+    int remove(const QString& path) override;
+
+   private:
+    static constexpr int opCount = 6;
+
+    struct Node {
+        bool isDir = false;
+        qint64 size = 0;
+        QDateTime modified;
+        quint64 inode = 0;
+    };
+    struct Mount {
+        qint64 capacity = -1;
+        qint64 used = 0;
+    };
+    struct Fault {
+        Op op;
+        QString prefix;
+        int error = 0;
+        int remaining = -1;
+    };
+
+    mutable QMutex mutex;
+    QHash<QString, Node> nodes;
+    QHash<QString, QSet<QString>> children;  // directory -> child names
+    QMap<QString, Mount> mounts;             // mount point -> usage
+    mutable QList<Fault> faults;
+    std::array<int, opCount> latency{};
+    mutable std::array<qint64, opCount> calls{};
+    quint64 nextInode = 1;
+
+    // Latency and injected faults for a call touching `path` (and
+    // `other`); call without the lock held
+    int enter(Op op,
+              const QString& path,
+              const QString& other = QString()) const;
+
+    static QString parentOf(const QString& path);
+    static QString nameOf(const QString& path);
+    static bool isBelow(const QString& path, const QString& prefix);
+    QString mountOf(const QString& path) const;
+    int makePath(const QString& path);
+    void insertNode(const QString& path, Node node);
+    void eraseNode(const QString& path);
+};
+
+#endif  // MEMORYFILESYSTEM_H
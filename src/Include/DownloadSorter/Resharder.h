@@ -0,0 +1,66 @@
+#ifndef RESHARDER_H
+#define RESHARDER_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QString>
+
+#include <memory>
+
+#include "FileSystem.h"
+
+// How a category folder is split into subfolders so that no single
+// directory grows without bound. Written as "" (flat), "year/month"
+// ("2024/05/", by modification time) or "hash:16", "hash:256", "hash:4096"
+// (one, two or three hex digits of a hash of the name).
+struct ShardLayout {
+    enum class Kind { Flat, YearMonth, Hash };
+
+    Kind kind = Kind::Flat;
+    int hashDigits = 0;  // Hash only
+
+    // Null `ok` accepts anything and falls back to flat
+    static ShardLayout parse(const QString& text, bool* ok = nullptr);
+    QString toString() const;
+
+    bool isFlat() const { return kind == Kind::Flat; }
+    // Levels of shard folders below the category folder
+    int depth() const;
+    // Whether a folder called `name`, `level` levels down, is one of ours
+    bool isShardName(const QString& name, int level) const;
+    // Shard of an entry, relative to the category folder ("" when flat)
+    QString subfolder(const QString& name, const QDateTime& modified) const;
+
+    bool operator==(const ShardLayout& other) const {
+        return kind == other.kind && hashDigits == other.hashDigits;
+    }
+    bool operator!=(const ShardLayout& other) const {
+        return !(*this == other);
+    }
+};
+
+// Moves what an existing category folder holds from one layout into another
+// (typically from flat into shards). The old shard folders are listed in
+// parallel and the renames are spread over a pool, each worker creating the
+// shard folders it needs; entries that clash with one already in place get
+// the sorter's "name (n)" treatment. Shard folders left empty are removed.
+class Resharder {
+   public:
+    struct Result {
+        int moved = 0;
+        int unchanged = 0;  // already where `to` wants them
+        int failed = 0;
+    };
+
+    explicit Resharder(
+        std::shared_ptr<FileSystem> fileSystem = FileSystem::local());
+
+    Result reshard(const QString& folder,
+                   const ShardLayout& from,
+                   const ShardLayout& to,
+                   int maxThreads) const;
+
+   private:
+    std::shared_ptr<FileSystem> fs;
+};
+
+#endif  // RESHARDER_H
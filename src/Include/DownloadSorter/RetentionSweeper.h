@@ -0,0 +1,70 @@
+#ifndef RETENTIONSWEEPER_H
+#define RETENTIONSWEEPER_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QString>
+
+#include "Resharder.h"
+
+// Limits for one category folder; 0 leaves a limit off
+struct RetentionRule {
+    int maxAgeDays = 0;
+    qint64 maxTotalMB = 0;
+    int keepNewest = 0;
+
+    bool isActive() const {
+        return maxAgeDays > 0 || maxTotalMB > 0 || keepNewest > 0;
+    }
+};
+
+// Enforces retention rules on the items directly inside the category folders
+// (or inside their shard folders, for sharded categories).
+// Items are ranked newest first; anything past `keepNewest`, older than
+// `maxAgeDays`, or beyond `maxTotalMB` of newer items is removed, oldest
+// first. Folders are listed in parallel, plain files are unlinked in batches
+// per directory, and directory trees are removed on their own workers.
+class RetentionSweeper {
+   public:
+    struct Item {
+        QString path;
+        qint64 size = 0;
+        QDateTime modified;
+        bool isDir = false;
+    };
+
+    struct Result {
+        QList<Item> victims;  // oldest first
+        int removed = 0;
+        int failed = 0;
+        qint64 bytesFreed = 0;
+    };
+
+    // Category folders live in `root` unless `destinationRoots` names
+    // another directory for them
+    RetentionSweeper(const QString& root,
+                     const QMap<QString, RetentionRule>& rules,
+                     const QMap<QString, QString>& destinationRoots = {},
+                     const QMap<QString, ShardLayout>& shardLayouts = {});
+
+    // Work out what the rules would remove without touching anything
+    Result plan(int maxThreads) const;
+
+    // plan(), then delete the victims
+    Result sweep(int maxThreads) const;
+
+    // Delete `victims` (e.g. a plan() the user confirmed) and nothing else
+    static Result remove(const QList<Item>& victims, int maxThreads);
+
+   private:
+    QString root;
+    QMap<QString, RetentionRule> rules;
+    QMap<QString, QString> destinationRoots;
+    QMap<QString, ShardLayout> shardLayouts;
+
+    static QList<Item> selectVictims(QList<Item> items,
+                                     const RetentionRule& rule);
+};
+
+#endif  // RETENTIONSWEEPER_H
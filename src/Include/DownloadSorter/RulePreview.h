@@ -0,0 +1,64 @@
+#ifndef RULEPREVIEW_H
+#define RULEPREVIEW_H
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <atomic>
+#include <memory>
+
+#include "RuleSet.h"
+
+// Evaluates edited rules against the top level of a download folder without
+// touching it. The listing is cached and reused until the folder itself
+// changes, so each keystroke only pays for the classification.
+namespace RulePreview {
+struct Entry {
+    QString name;
+    bool isDir = false;
+};
+using Snapshot = QVector<Entry>;
+
+// Cached listing of `root`; re-read when the folder's mtime moves
+std::shared_ptr<const Snapshot> snapshot(const QString& root);
+
+// Classify every entry. Returns false (leaving `out` partial) as soon as
+// `generation` no longer equals `expected`.
+bool evaluate(const Snapshot& entries,
+              const RuleSet& rules,
+              const std::atomic<int>& generation,
+              int expected,
+              QVector<RuleSet::Decision>* out);
+}  // namespace RulePreview
+
+// Entry -> destination rows for the preview pane, fetched in batches
+class PreviewModel : public QAbstractTableModel {
+    Q_OBJECT
+
+   public:
+    struct Row {
+        QString entry;
+        QString result;
+    };
+
+    using QAbstractTableModel::QAbstractTableModel;
+
+    void setRows(QVector<Row> rows);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+    QVariant data(const QModelIndex& index,
+                  int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section,
+                        Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+   private:
+    QVector<Row> rows;
+    int fetched = 0;
+};
+
+#endif  // RULEPREVIEW_H
@@ -0,0 +1,43 @@
+#ifndef RULESET_H
+#define RULESET_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QString>
+
+// The sorting rules in lookup form: one hash probe per suffix plus the
+// compiled ignore regexes. DownloadSorter and the settings preview both
+// classify entries through this, so the preview shows exactly what a sort
+// would do.
+class RuleSet {
+   public:
+    static inline const QList<QString> builtinFolders = {
+        "Downloaded Archives", "Downloaded Audios",   "Downloaded Documents",
+        "Downloaded Fonts",    "Downloaded Images",   "Downloaded Programs",
+        "Downloaded Videos",   "Downloaded Folders"};
+    // Where every directory goes
+    static inline const QString foldersCategory =
+        QStringLiteral("Downloaded Folders");
+
+    enum class Outcome { Move, Ignored, Unrecognized, CategoryFolder };
+
+    struct Decision {
+        Outcome outcome = Outcome::Unrecognized;
+        QString folder;        // destination category when moving
+        int ignoreIndex = -1;  // matching ignore expression when ignored
+    };
+
+    RuleSet() = default;
+    RuleSet(const QMap<QString, QList<QString>>& mappings,
+            const QList<QRegularExpression>& ignorePatterns);
+
+    Decision classify(const QString& fileName, bool isDir) const;
+
+   private:
+    QHash<QString, QString> folderBySuffix;
+    QList<QRegularExpression> ignorePatterns;
+};
+
+#endif  // RULESET_H
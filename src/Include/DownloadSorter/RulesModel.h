@@ -0,0 +1,158 @@
+#ifndef RULESMODEL_H
+#define RULESMODEL_H
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+#include "Resharder.h"
+
+// Base for the rule editors in SettingsDialog. Rows are filtered inside the
+// model and handed to the view in batches through fetchMore(), so a rule set
+// with thousands of rows opens without materializing all of them. Each row
+// can carry a problem message found by background validation; such rows are
+// drawn in red with the message as their tooltip.
+class RulesModel : public QAbstractTableModel {
+    Q_OBJECT
+
+   public:
+    explicit RulesModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+    // Case-insensitive substring filter over every column
+    void setFilter(const QString& text);
+
+    // Bumped by every edit (anything that emits rulesEdited)
+    int revision() const { return this->editRevision; }
+    // Problems by source row, found in the rows as of `revision`; ignored
+    // if they have been edited since
+    void setProblems(const QVector<QString>& problems, int revision);
+    int problemCount() const;
+
+    void removeViewRow(int row);
+    // Row in the underlying list, or -1
+    int sourceRow(const QModelIndex& index) const;
+
+   signals:
+    // Rows were added, removed or edited (not emitted for new problems)
+    void rulesEdited();
+
+   protected:
+    QVector<QString> problems;
+
+    virtual int sourceRowCount() const = 0;
+    virtual bool rowMatches(int sourceRow, const QString& filter) const = 0;
+    virtual void eraseSourceRow(int sourceRow) = 0;
+
+    QVariant problemData(int sourceRow, int role) const;
+
+    // Call inside begin/endResetModel after replacing the rows
+    void resetRows();
+    // Call after appending a source row; returns its view row
+    int showAppendedRow();
+
+   private:
+    QString filter;
+    QVector<int> visible;  // view row -> source row
+    int fetched = 0;
+    int editRevision = 0;
+};
+
+// Folder -> extensions table, with an optional destination root and shard
+// layout per folder.
+// Extensions are kept as lists; the joined text only exists for rows the
+// view actually shows.
+class MappingsModel : public RulesModel {
+    Q_OBJECT
+
+   public:
+    struct Row {
+        QString folder;
+        QStringList extensions;
+        QString root;      // empty: the download folder
+        QString sharding;  // ShardLayout text; empty: flat
+    };
+
+    using RulesModel::RulesModel;
+
+    void setMappings(const QMap<QString, QList<QString>>& mappings,
+                     const QMap<QString, QString>& roots = {},
+                     const QMap<QString, ShardLayout>& layouts = {});
+    QMap<QString, QList<QString>> mappings() const;
+    // Folder -> root for the rows that name one
+    QMap<QString, QString> destinationRoots() const;
+    // Folder -> layout for the rows that are not flat
+    QMap<QString, ShardLayout> shardLayouts() const;
+    const QVector<Row>& rows() const { return this->all; }
+
+    // Returns the view row of the new mapping
+    int addRow(const Row& row);
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index,
+                  int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex& index,
+                 const QVariant& value,
+                 int role = Qt::EditRole) override;
+    QVariant headerData(int section,
+                        Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+    // Empty folders or extension lists, repeated folders, extensions claimed
+    // by more than one folder, missing roots and unknown shard layouts; safe
+    // to run on any thread
+    static QVector<QString> validate(const QVector<Row>& rows);
+
+    // Accepts "a, b", "a,b", ".a .b" and the like
+    static QStringList parseExtensions(const QString& text);
+
+   protected:
+    int sourceRowCount() const override { return this->all.size(); }
+    bool rowMatches(int sourceRow, const QString& filter) const override;
+    void eraseSourceRow(int sourceRow) override;
+
+   private:
+    QVector<Row> all;
+};
+
+// Ignore regexes, one per row
+class IgnorePatternsModel : public RulesModel {
+    Q_OBJECT
+
+   public:
+    using RulesModel::RulesModel;
+
+    void setPatterns(const QList<QString>& patterns);
+    QList<QString> patterns() const;
+    const QStringList& rows() const { return this->all; }
+
+    // Returns the view row of the new pattern
+    int addRow(const QString& pattern);
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index,
+                  int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex& index,
+                 const QVariant& value,
+                 int role = Qt::EditRole) override;
+
+    // Regex compile errors with their offsets; safe to run on any thread
+    static QVector<QString> validate(const QStringList& patterns);
+
+   protected:
+    int sourceRowCount() const override { return this->all.size(); }
+    bool rowMatches(int sourceRow, const QString& filter) const override;
+    void eraseSourceRow(int sourceRow) override;
+
+   private:
+    QStringList all;
+};
+
+#endif  // RULESMODEL_H
@@ -4,14 +4,29 @@
 #include <QDialog>
 #include <QList>
 #include <QMap>
+#include <QPersistentModelIndex>
+#include <QThreadPool>
+
+#include <atomic>
+
+#include "DownloadSorter.h"  // for DuplicateFolders
+#include "RetentionSweeper.h"
 
 class QVBoxLayout;
 class QHBoxLayout;
 class QLabel;
 class QLineEdit;
 class QPushButton;
-class QListWidget;
+class QCheckBox;
+class QComboBox;
+class QListView;
+class QSpinBox;
+class QTableView;
 class QTableWidget;
+class QTimer;
+class IgnorePatternsModel;
+class MappingsModel;
+class PreviewModel;
 
 class SettingsDialog : public QDialog {
     Q_OBJECT
@@ -20,29 +35,87 @@ class SettingsDialog : public QDialog {
     explicit SettingsDialog(QWidget* parent = nullptr);
     ~SettingsDialog();
 
-    void setMappings(const QMap<QString, QList<QString>>& mappings);
+    void setMappings(const QMap<QString, QList<QString>>& mappings,
+                     const QMap<QString, QString>& roots = {},
+                     const QMap<QString, ShardLayout>& layouts = {});
     QMap<QString, QList<QString>> getMappings() const;
+    QMap<QString, QString> getDestinationRoots() const;
+    QMap<QString, ShardLayout> getShardLayouts() const;
     void setIgnorePatterns(const QList<QString>& patterns);
     QList<QString> getIgnorePatterns() const;
+    void setColdStorageAgeDays(int days);
+    int getColdStorageAgeDays() const;
+    void setRetentionRules(const QMap<QString, RetentionRule>& rules);
+    QMap<QString, RetentionRule> getRetentionRules() const;
+    void setViewMode(bool enabled, const QString& folder);
+    bool getViewMode() const;
+    QString getViewFolder() const;
+    void setLayoutOrderedCopies(bool enabled);
+    bool getLayoutOrderedCopies() const;
+    void setExtractArchives(bool enabled);
+    bool getExtractArchives() const;
+    void setDuplicateFolders(DuplicateFolders action);
+    DuplicateFolders getDuplicateFolders() const;
+
+    // Download folder the live rule preview is evaluated against
+    void setPreviewFolder(const QString& folder);
 
     static bool getSettings(QWidget* parent,
                             QMap<QString, QList<QString>>& mappings,
                             QList<QString>& ignorePatterns);
-    static bool editSettings(QWidget* parent);
+    static bool editSettings(QWidget* parent,
+                             const QString& downloadFolder = QString());
 
    private slots:
     void addMapping();
     void removeMapping();
     void addIgnorePattern();
     void removeIgnorePattern();
+    void validateRules();
+    void updatePreview();
+    void addRetentionRule();
+    void removeRetentionRule();
 
    private:
-    QTableWidget* mappingsTable;
-    QListWidget* ignoreList;
+    MappingsModel* mappingsModel;
+    IgnorePatternsModel* ignoreModel;
+    QTableView* mappingsView;
+    QListView* ignoreView;
+    QLineEdit* ruleFilter;
+    QLabel* problemsLabel;
     QPushButton* addMappingBtn;
     QPushButton* removeMappingBtn;
     QPushButton* addIgnoreBtn;
     QPushButton* removeIgnoreBtn;
+    QSpinBox* coldStorageSpin;
+    QTableWidget* retentionTable;
+    QPushButton* addRetentionBtn;
+    QPushButton* removeRetentionBtn;
+    QCheckBox* viewModeCheck;
+    QLineEdit* viewFolderEdit;
+    QCheckBox* layoutOrderCheck;
+    QCheckBox* extractArchivesCheck;
+    QComboBox* duplicateFoldersCombo;
+
+    // Rules are re-checked off the GUI thread shortly after each edit; a
+    // result is dropped if another edit happened while it ran
+    QTimer* validationTimer;
+    QThreadPool validationPool;
+    int validationGeneration = 0;
+
+    // Live preview: every edit (down to single keystrokes in an open editor)
+    // bumps the generation, which stops any evaluation still running
+    QString previewFolder;
+    QWidget* previewGroup;
+    PreviewModel* previewModel;
+    QLabel* previewSummary;
+    QThreadPool previewPool;
+    std::atomic<int> previewGeneration{0};
+    // Text of the cell being edited, not yet committed to a model
+    QPersistentModelIndex editingIndex;
+    QString editingText;
+    // Which list the preview narrows to: its current row's rule
+    bool previewIgnoreFocus = false;
 };
 
 #endif  // SETTINGSDIALOG_H
@@ -4,6 +4,7 @@
 #include <QList>
 #include <QMap>
 #include <QString>
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QJsonArray>
@@ -24,6 +25,49 @@ class SettingsManager {
         return dir.filePath("DownloadSorter/mappings.json");
     }
 
+    // Path for state files (indexes, caches) kept next to the settings
+    static QString dataPath(const QString& fileName) {
+        const QString base =
+            QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
+        QDir dir(base);
+        dir.mkpath("DownloadSorter");
+        return dir.filePath("DownloadSorter/" + fileName);
+    }
+
+    // Short stable key for per-download-folder state files
+    static QString rootKey(const QString& root) {
+        return QString::fromLatin1(
+            QCryptographicHash::hash(QDir::cleanPath(root).toUtf8(),
+                                     QCryptographicHash::Sha1)
+                .toHex()
+                .left(16));
+    }
+
+    // Settings-file names of the DuplicateFolders actions; anything unknown
+    // renames, as before there was a choice
+    static DuplicateFolders duplicateFoldersFromString(const QString& text) {
+        if (text == QLatin1String("skip"))
+            return DuplicateFolders::Skip;
+        if (text == QLatin1String("remove"))
+            return DuplicateFolders::Remove;
+        if (text == QLatin1String("link"))
+            return DuplicateFolders::Link;
+        return DuplicateFolders::Rename;
+    }
+    static QString duplicateFoldersToString(DuplicateFolders action) {
+        switch (action) {
+            case DuplicateFolders::Skip:
+                return QStringLiteral("skip");
+            case DuplicateFolders::Remove:
+                return QStringLiteral("remove");
+            case DuplicateFolders::Link:
+                return QStringLiteral("link");
+            case DuplicateFolders::Rename:
+                break;
+        }
+        return QStringLiteral("rename");
+    }
+
     // Default seed for first-run or corrupted/missing files
     static SettingsData defaults() {
         SettingsData d;
@@ -84,11 +128,70 @@ class SettingsManager {
         for (const auto& v : ignoreArr)
             data.ignorePatterns.append(v.toString());
 
+        data.coldStorageAgeDays =
+            obj.value(QStringLiteral("coldStorageAgeDays")).toInt(0);
+
+        // retention rules
+        for (const auto& v : obj.value(QStringLiteral("retention")).toArray()) {
+            const auto o = v.toObject();
+            const QString folder = o.value(QStringLiteral("folder")).toString();
+            RetentionRule rule;
+            rule.maxAgeDays = o.value(QStringLiteral("maxAgeDays")).toInt(0);
+            rule.maxTotalMB =
+                o.value(QStringLiteral("maxTotalMB")).toInteger(0);
+            rule.keepNewest = o.value(QStringLiteral("keepNewest")).toInt(0);
+            if (!folder.isEmpty() && rule.isActive())
+                data.retention.insert(folder, rule);
+        }
+
+        data.viewMode = obj.value(QStringLiteral("viewMode")).toBool(false);
+        data.viewFolder = obj.value(QStringLiteral("viewFolder")).toString();
+
+        data.layoutOrderedCopies =
+            obj.value(QStringLiteral("layoutOrderedCopies")).toBool(false);
+        data.extractArchives =
+            obj.value(QStringLiteral("extractArchives")).toBool(false);
+        data.duplicateFolders = duplicateFoldersFromString(
+            obj.value(QStringLiteral("duplicateFolders")).toString());
+
+        // per-category destination roots
+        const auto rootsObj =
+            obj.value(QStringLiteral("destinationRoots")).toObject();
+        for (auto it = rootsObj.begin(); it != rootsObj.end(); ++it) {
+            const QString root = it.value().toString().trimmed();
+            if (!root.isEmpty())
+                data.destinationRoots.insert(it.key(), root);
+        }
+
+        // per-category shard layouts; unknown ones stay flat
+        const auto shardingObj =
+            obj.value(QStringLiteral("sharding")).toObject();
+        for (auto it = shardingObj.begin(); it != shardingObj.end(); ++it) {
+            const ShardLayout layout =
+                ShardLayout::parse(it.value().toString());
+            if (!layout.isFlat())
+                data.shardLayouts.insert(it.key(), layout);
+        }
+
         // seed if mappings empty
         if (data.mappings.isEmpty()) {
             data = defaults();
             write(data);
         }
+
+        // Retention only applies to category folders; any other name (".",
+        // an absolute path) would sweep the download folder or beyond
+        const QList<QString> folders =
+            DownloadSorter::managedFolders(data.mappings);
+        for (auto it = data.retention.begin(); it != data.retention.end();) {
+            if (folders.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            qWarning() << "Ignoring retention rule for" << it.key()
+                       << ": not a category folder";
+            it = data.retention.erase(it);
+        }
         return data;
     }
 
@@ -116,6 +219,49 @@ class SettingsManager {
             ignoreArr.append(p);
         obj.insert(QStringLiteral("ignorePatterns"), ignoreArr);
 
+        obj.insert(QStringLiteral("coldStorageAgeDays"),
+                   data.coldStorageAgeDays);
+
+        // retention rules
+        QJsonArray retentionArr;
+        for (auto it = data.retention.constBegin();
+             it != data.retention.constEnd(); ++it) {
+            if (!it.value().isActive())
+                continue;
+            QJsonObject o;
+            o.insert(QStringLiteral("folder"), it.key());
+            o.insert(QStringLiteral("maxAgeDays"), it.value().maxAgeDays);
+            o.insert(QStringLiteral("maxTotalMB"), it.value().maxTotalMB);
+            o.insert(QStringLiteral("keepNewest"), it.value().keepNewest);
+            retentionArr.append(o);
+        }
+        obj.insert(QStringLiteral("retention"), retentionArr);
+
+        obj.insert(QStringLiteral("viewMode"), data.viewMode);
+        obj.insert(QStringLiteral("viewFolder"), data.viewFolder);
+
+        obj.insert(QStringLiteral("layoutOrderedCopies"),
+                   data.layoutOrderedCopies);
+        obj.insert(QStringLiteral("extractArchives"), data.extractArchives);
+        obj.insert(QStringLiteral("duplicateFolders"),
+                   duplicateFoldersToString(data.duplicateFolders));
+
+        QJsonObject rootsObj;
+        for (auto it = data.destinationRoots.constBegin();
+             it != data.destinationRoots.constEnd(); ++it) {
+            if (!it.value().isEmpty())
+                rootsObj.insert(it.key(), it.value());
+        }
+        obj.insert(QStringLiteral("destinationRoots"), rootsObj);
+
+        QJsonObject shardingObj;
+        for (auto it = data.shardLayouts.constBegin();
+             it != data.shardLayouts.constEnd(); ++it) {
+            if (!it.value().isFlat())
+                shardingObj.insert(it.key(), it.value().toString());
+        }
+        obj.insert(QStringLiteral("sharding"), shardingObj);
+
         QFile f(configPath());
         if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
             return false;
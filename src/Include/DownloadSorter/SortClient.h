@@ -0,0 +1,53 @@
+#ifndef SORTCLIENT_H
+#define SORTCLIENT_H
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMap>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtNetwork/QLocalSocket>
+
+// Talks to a running SortService. Events for the jobs this client asked for
+// are re-emitted with the same signals DownloadSorter uses, so callers can
+// wire either one up the same way.
+class SortClient : public QObject {
+    Q_OBJECT
+
+   public:
+    explicit SortClient(QObject* parent = nullptr);
+
+    // Non-blocking; check isConnected() or waitForConnected() afterwards
+    void connectToService();
+    bool waitForConnected(int msecs);
+    bool isConnected() const;
+
+    // Start a detached resident service for later connections
+    static bool launchService();
+
+    void sort(const QString& root);
+    void dryRun(const QString& root);
+    void cancel(const QString& root);
+    void requestStatus();
+
+   signals:
+    void progressRangeChanged(int minimum, int maximum);
+    void progressValueChanged(int value);
+    void statusMessage(const QString& message);
+    void planReady(const QMap<QString, QString>& plan);
+    void contentsMoved(const QMap<QString, QString>& moved);
+    void categoriesChanged();
+    void statusReport(const QJsonArray& jobs);
+    void errorMessage(const QString& message);
+    // `completed` is false if the sort left planned items unmoved
+    void finished(bool completed);
+    void disconnected();
+
+   private:
+    QLocalSocket* socket = nullptr;
+
+    void send(const QJsonObject& request);
+    void onReadyRead();
+};
+
+#endif  // SORTCLIENT_H
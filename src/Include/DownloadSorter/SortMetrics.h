@@ -0,0 +1,70 @@
+#ifndef SORTMETRICS_H
+#define SORTMETRICS_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Process-wide counters for long-running sorters (the service, --watch),
+// exported in the Prometheus text format. Every thread that records gets
+// its own shard and only ever writes to that one, with plain relaxed stores,
+// so the move path never contends; shards are summed when the exposition is
+// built. Shards of finished threads are handed to the next new thread, so
+// totals survive pool threads coming and going.
+class SortMetrics {
+   public:
+    static SortMetrics& instance();
+
+    // A finished move: `copied` if it needed the cross-device fallback
+    void recordMove(const QString& category,
+                    qint64 bytes,
+                    bool copied,
+                    qint64 nanoseconds);
+    // A move that failed with `error` (an errno value)
+    void recordFailure(int error);
+    // Planned moves not yet attempted (negative once done)
+    void addQueued(qint64 delta) { this->queued += delta; }
+    // Operations in flight the last sort's move limiters settled at
+    void setConcurrency(int renames, int copies) {
+        this->renameConcurrency = renames;
+        this->copyConcurrency = copies;
+    }
+
+    QByteArray exposition() const;
+    // Atomically replace `path` (for a node_exporter textfile directory)
+    bool writeTo(const QString& path) const;
+
+   private:
+    // Categories past this share the last slot
+    static constexpr int categorySlots = 64;
+    // Latency buckets are powers of two of microseconds: < 1us ... < 2^31us
+    static constexpr int latencyBuckets = 32;
+    static constexpr int errorSlots = 8;
+
+    struct Shard;
+    struct Lease;
+
+    mutable QMutex registry;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<Shard*> idle;
+    QHash<QString, int> slotByCategory;
+    QStringList categories;
+    std::atomic<qint64> queued{0};
+    std::atomic<int> renameConcurrency{0};
+    std::atomic<int> copyConcurrency{0};
+
+    SortMetrics();
+    ~SortMetrics();
+
+    Shard& local();
+    int categorySlot(const QString& category);
+    void release(Shard* shard);
+};
+
+#endif  // SORTMETRICS_H
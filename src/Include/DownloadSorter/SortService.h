@@ -0,0 +1,79 @@
+#ifndef SORTSERVICE_H
+#define SORTSERVICE_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
+
+#include "DownloadSorter.h"  // for SettingsData
+
+// Resident process that runs sorts on behalf of Dashboard windows and
+// command-line clients. Requests and events are newline-delimited JSON
+// objects sent over a QLocalServer socket:
+//
+//   -> {"cmd": "sort" | "dry-run" | "cancel", "root": "<folder>"}
+//   -> {"cmd": "status"}
+//   <- {"event": "range" | "value" | "status" | "plan" | "moved" |
+//       "finished" | "error" | "jobs", "root": "<folder>", ...}
+//
+// Settings and compiled ignore rules are kept warm between requests, and a
+// request for a root that is already being sorted joins the running job
+// instead of starting a second scan.
+class SortService : public QObject {
+    Q_OBJECT
+
+   public:
+    explicit SortService(QObject* parent = nullptr);
+    ~SortService();
+
+    static QString serverName();
+
+    // Fails if another service is already listening
+    bool listen();
+
+   private:
+    struct Job {
+        DownloadSorter* sorter = nullptr;
+        QString root;
+        bool dryRun = false;
+        QList<QPointer<QLocalSocket>> clients;
+        int minimum = 0;
+        int maximum = 0;
+        int value = 0;
+        QString message;
+    };
+
+    QLocalServer* server = nullptr;
+    QHash<QString, Job> jobs;  // keyed by normalized root
+    int connections = 0;
+
+    SettingsData settings;
+    QDateTime settingsStamp;
+    QList<QRegularExpression> compiledIgnorePatterns;
+
+    // Exit after sitting idle so an auto-started service does not linger
+    QTimer* idleTimer = nullptr;
+
+    void onNewConnection();
+    void onReadyRead(QLocalSocket* socket);
+    void handleRequest(QLocalSocket* socket, const QJsonObject& request);
+    void startJob(QLocalSocket* socket, const QString& root, bool dryRun);
+    void cancelJob(QLocalSocket* socket, const QString& root);
+    void reportJobs(QLocalSocket* socket);
+    void broadcast(const QString& key, QJsonObject event);
+    void reloadSettingsIfChanged();
+    void updateIdleTimer();
+
+    static QString jobKey(const QString& root);
+    static void send(QLocalSocket* socket, const QJsonObject& event);
+};
+
+#endif  // SORTSERVICE_H
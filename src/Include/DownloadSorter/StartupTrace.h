@@ -0,0 +1,22 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <functional>
+
+class QWidget;
+
+// Cold-start timing. With DOWNLOADSORTER_TRACE_STARTUP set (or
+// --trace-startup on the command line) every mark prints the milliseconds
+// since main() was entered; otherwise marks cost a single branch.
+namespace StartupTrace {
+// Call first thing in main()
+void begin(int argc, char* argv[]);
+bool enabled();
+void mark(const char* label);
+
+// Run `then` once `window` has painted its first frame. Always active, so
+// work that is not visible at startup can wait for it.
+void onFirstFrame(QWidget* window, std::function<void()> then);
+}  // namespace StartupTrace
+
+#endif  // STARTUPTRACE_H
@@ -0,0 +1,73 @@
+#ifndef STORAGESTATS_H
+#define STORAGESTATS_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include <array>
+
+#include "Resharder.h"
+
+// Per-category item counts, sizes and size/age histograms for one download
+// folder. Kept up to date by every sort and persisted between runs, so the
+// numbers are available without walking the category folders; a full walk
+// only happens occasionally to correct drift.
+class StorageStats {
+   public:
+    // <4 KiB, <64 KiB, <1 MiB, <16 MiB, <256 MiB, <4 GiB, larger
+    static constexpr int sizeBucketCount = 7;
+    // <1 day, <1 week, <1 month, <3 months, <1 year, older
+    static constexpr int ageBucketCount = 6;
+
+    struct Category {
+        qint64 count = 0;
+        qint64 bytes = 0;
+        std::array<qint64, sizeBucketCount> sizes{};
+        // Items per modification day (days since epoch); ages are derived
+        // from this at read time so they never go stale
+        QMap<qint64, qint64> days;
+    };
+
+    StorageStats() = default;
+    explicit StorageStats(const QString& root) { this->load(root); }
+
+    bool load(const QString& root);
+    bool save() const;
+
+    void record(const QString& category, qint64 size, const QDateTime& mtime);
+
+    const QMap<QString, Category>& categories() const {
+        return this->stats;
+    }
+    QDateTime lastReconciled() const { return this->reconciled; }
+    bool needsReconcile() const;
+    void invalidate() { this->reconciled = QDateTime(); }
+
+    // Re-walk the given category folders in parallel and replace their
+    // numbers with exact ones. Shard folders (by category name in
+    // `shardLayouts`) are walked through, so their entries count one by one
+    // as a sort records them.
+    void reconcile(const QStringList& categoryFolders,
+                   const QMap<QString, ShardLayout>& shardLayouts = {});
+
+    static std::array<qint64, ageBucketCount> ageHistogram(
+        const Category& category);
+    static QString sizeBucketLabel(int bucket);
+    static QString ageBucketLabel(int bucket);
+
+    // Size of a file, or of everything below a directory
+    static qint64 entrySize(const QString& path);
+
+   private:
+    QString root;
+    QDateTime reconciled;
+    QMap<QString, Category> stats;
+
+    static int sizeBucket(qint64 size);
+    static QString statsPath(const QString& root);
+};
+
+#endif  // STORAGESTATS_H
@@ -0,0 +1,73 @@
+#ifndef TREEHASHER_H
+#define TREEHASHER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+// Tells a folder that holds exactly what an already sorted one holds from
+// one that only shares its name. Trees are compared by shape first: the
+// relative paths, types and sizes of everything in them, which takes a
+// metadata walk and no reads and rules out almost every pair. Only trees of
+// the same shape are hashed, Merkle style: the files on a pool, then every
+// directory over its children's names and hashes, deepest first. File
+// hashes are cached across runs (keyed by path, checked against size and
+// modification time), so a folder that is compared again is not re-read.
+class TreeHasher {
+   public:
+    // Cache file per download folder
+    TreeHasher(const QString& root, int maxThreads);
+
+    // First of `candidates` with the same content as `dir`, or "" if none
+    QString findIdentical(const QString& dir, const QStringList& candidates);
+    // Merkle hash of `dir`; empty if any file in it could not be read
+    QByteArray hash(const QString& dir);
+    // Whether `dir` and `other` hold the same content, reading every file
+    // of both again: a cached hash is only as good as the size and time it
+    // was checked against, which is not enough to delete a folder on
+    bool verifyIdentical(const QString& dir, const QString& other);
+
+    // Writes the cache back, dropping entries unused for a while
+    bool save();
+
+    // Recreate `original` at `to` with every file hardlinked to the
+    // original's. Returns 0 or an errno value (EXDEV across devices); a
+    // partial tree is removed again.
+    static int linkTree(const QString& original, const QString& to);
+
+   private:
+    struct Node {
+        QString rel;  // "a/b.txt" below the tree's root
+        char type;    // 'd'irectory, 'f'ile or 'l'ink
+        qint64 size;  // files only
+        qint64 modified;
+        QString target;  // links only
+    };
+    struct Walk {
+        QVector<Node> nodes;  // sorted by rel
+        QByteArray shape;
+    };
+    struct Cached {
+        qint64 size = 0;
+        qint64 modified = 0;
+        qint64 used = 0;  // days since epoch
+        QByteArray hash;
+    };
+
+    QString cachePath;
+    int maxThreads;
+    QMutex mutex;
+    QHash<QString, Cached> cache;
+    bool dirty = false;
+
+    static Walk walk(const QString& dir);
+    QByteArray merkle(const QString& dir,
+                      const QVector<Node>& nodes,
+                      bool useCache = true);
+    QByteArray fileHash(const QString& path, const Node& node, bool useCache);
+};
+
+#endif  // TREEHASHER_H
@@ -0,0 +1,33 @@
+#ifndef TREETRANSFER_H
+#define TREETRANSFER_H
+
+#include <QtCore/QString>
+
+// Moves a directory tree to another device. The source is walked breadth
+// first, one listing task per directory of a level; each destination
+// directory is created as soon as its parent has been listed, and its files
+// are handed to a pool of copy workers right away, so copying overlaps the
+// walk. Files keep their permission bits and timestamps, symlinks are
+// recreated as links, and every file is flushed and its size checked. The
+// source is only deleted once the whole copy has been verified; on any
+// failure the partial copy is deleted instead.
+class TreeTransfer {
+   public:
+    struct Result {
+        int error = 0;  // errno of the first failure, 0 on success
+        int files = 0;
+        int directories = 0;
+        int links = 0;
+        qint64 bytes = 0;
+    };
+
+    explicit TreeTransfer(int maxThreads);
+
+    // `to` must not exist yet (EEXIST)
+    Result move(const QString& from, const QString& to) const;
+
+   private:
+    int maxThreads;
+};
+
+#endif  // TREETRANSFER_H
@@ -0,0 +1,8 @@
+#include "./Include/DownloadSorter/CommandLine.h"
+
+// Widget-free build of the headless modes (--sort, --service, --watch, ...).
+// Links only QtCore and QtNetwork, so batch runs start without loading the
+// widget stack at all.
+int main(int argc, char* argv[]) {
+    return CommandLine::run(argc, argv);
+}
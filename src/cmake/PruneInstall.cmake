@@ -27,8 +27,6 @@ _rm_glob("${CMAKE_INSTALL_PREFIX}/*d.dll")
 _rm_glob("${CMAKE_INSTALL_PREFIX}/bin/*d.dll")
 
 # Remove unused Qt modules
-_rm_glob("${CMAKE_INSTALL_PREFIX}/Qt6Network.dll")
-_rm_glob("${CMAKE_INSTALL_PREFIX}/bin/Qt6Network.dll")
 _rm_glob("${CMAKE_INSTALL_PREFIX}/Qt6Concurrent.dll")
 _rm_glob("${CMAKE_INSTALL_PREFIX}/bin/Qt6Concurrent.dll")
 _rm_glob("${CMAKE_INSTALL_PREFIX}/Qt6PrintSupport.dll")
@@ -5,8 +5,10 @@
 #include <QtGui/QIcon>
 #include <QtWidgets/QApplication>
 
+#include "./Include/DownloadSorter/CommandLine.h"
 #include "./Include/DownloadSorter/Dashboard.h"
 #include "./Include/DownloadSorter/DownloadSorter.h"
+#include "./Include/DownloadSorter/StartupTrace.h"
 
 static QString readVersionFromManifest() {
 #ifdef APP_VERSION
@@ -17,10 +19,17 @@ static QString readVersionFromManifest() {
 }
 
 int main(int argc, char* argv[]) {
-    QApplication* app = new QApplication(argc, argv);
-    // Set app-wide icon (used by taskbar/dock)
+    StartupTrace::begin(argc, argv);
 
-    app->setWindowIcon(QIcon(":/appicon"));
+    // --service, --sort, --dry-run, ... run without any widgets
+    if (CommandLine::isHeadless(argc, argv))
+        return CommandLine::run(argc, argv);
+
+    QApplication app(argc, argv);
+    StartupTrace::mark("QApplication");
+
+    // Set app-wide icon (used by taskbar/dock and inherited by the window)
+    app.setWindowIcon(QIcon(":/appicon"));
 
     // Set application version from manifest (with compile-time fallback)
     QCoreApplication::setApplicationVersion(readVersionFromManifest());
@@ -35,6 +44,7 @@ int main(int argc, char* argv[]) {
 
     Dashboard dashboard;
     dashboard.show();
+    StartupTrace::mark("show");
 
-    return app->exec();
+    return app.exec();
 }
\ No newline at end of file
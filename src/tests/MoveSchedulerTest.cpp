@@ -0,0 +1,143 @@
+#include "../Include/DownloadSorter/DownloadSorter.h"
+#include "../Include/DownloadSorter/MemoryFileSystem.h"
+
+#include <QtCore/QStandardPaths>
+#include <QtTest/QtTest>
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+
+// The move scheduler against MemoryFileSystem: renames that fail with EXDEV
+// fall back to copies, a full destination or a source that cannot be removed
+// leaves the source in place, and one failed move does not stop the others.
+// Storage stats are written under Qt's test-mode locations, never the
+// user's own.
+class MoveSchedulerTest : public QObject {
+    Q_OBJECT
+
+   private:
+    struct Sorted {
+        QMap<QString, QString> moved;
+        QList<int> progress;
+    };
+
+    // Sorts /downloads, with videos going to "<videoRoot>/Downloaded Videos"
+    // (the download folder if empty)
+    static Sorted sort(const std::shared_ptr<MemoryFileSystem>& fs,
+                       const QString& videoRoot = QString()) {
+        DownloadSorter sorter(QStringLiteral("/downloads"));
+        sorter.setFileSystem(fs);
+        sorter.setFileTypesMap(
+            {{QStringLiteral("Downloaded Videos"), {QStringLiteral("mp4")}}});
+        if (!videoRoot.isEmpty()) {
+            sorter.setDestinationRoots(
+                {{QStringLiteral("Downloaded Videos"), videoRoot},
+                 {QStringLiteral("Downloaded Folders"), videoRoot}});
+        }
+
+        Sorted result;
+        SortCallbacks callbacks;
+        callbacks.contentsMoved = [&result](const QMap<QString, QString>& m) {
+            result.moved = m;
+        };
+        callbacks.progress = [&result](int value) {
+            result.progress.append(value);
+        };
+        sorter.setCallbacks(callbacks);
+        sorter.run();
+        return result;
+    }
+
+   private slots:
+    void initTestCase() { QStandardPaths::setTestModeEnabled(true); }
+
+    void renamesWithinDevice() {
+        auto fs = std::make_shared<MemoryFileSystem>();
+        fs->addFile(QStringLiteral("/downloads/a.mp4"), 100);
+
+        const Sorted sorted = sort(fs);
+        QCOMPARE(sorted.moved.size(), 1);
+        QVERIFY(
+            fs->exists(QStringLiteral("/downloads/Downloaded Videos/a.mp4")));
+        QVERIFY(!fs->exists(QStringLiteral("/downloads/a.mp4")));
+        QCOMPARE(fs->callCount(MemoryFileSystem::Op::Copy), 0);
+    }
+
+    void copiesAcrossDevices() {
+        auto fs = std::make_shared<MemoryFileSystem>();
+        fs->mount(QStringLiteral("/archive"));
+        fs->addFile(QStringLiteral("/downloads/a.mp4"), 100);
+        fs->addFile(QStringLiteral("/downloads/album/b.txt"), 10);
+        fs->addFile(QStringLiteral("/downloads/album/inner/c.txt"), 10);
+
+        const Sorted sorted = sort(fs, QStringLiteral("/archive"));
+        QCOMPARE(sorted.moved.size(), 2);
+        QVERIFY(
+            fs->exists(QStringLiteral("/archive/Downloaded Videos/a.mp4")));
+        QVERIFY(fs->exists(
+            QStringLiteral("/archive/Downloaded Folders/album/inner/c.txt")));
+        QVERIFY(!fs->exists(QStringLiteral("/downloads/a.mp4")));
+        QVERIFY(!fs->exists(QStringLiteral("/downloads/album")));
+        // One file on its own, two through the directory fallback
+        QCOMPARE(fs->callCount(MemoryFileSystem::Op::Copy), 3);
+    }
+
+    void fullDestinationKeepsSource() {
+        auto fs = std::make_shared<MemoryFileSystem>();
+        fs->mount(QStringLiteral("/archive"), 50);
+        fs->addFile(QStringLiteral("/downloads/big.mp4"), 100);
+        fs->addFile(QStringLiteral("/downloads/small.mp4"), 10);
+
+        const Sorted sorted = sort(fs, QStringLiteral("/archive"));
+        QCOMPARE(sorted.moved.keys(),
+                 QStringList{QStringLiteral("/downloads/small.mp4")});
+        QVERIFY(fs->exists(QStringLiteral("/downloads/big.mp4")));
+        QVERIFY(
+            !fs->exists(QStringLiteral("/archive/Downloaded Videos/big.mp4")));
+    }
+
+    void undeletableSourceTakesCopyBack() {
+        auto fs = std::make_shared<MemoryFileSystem>();
+        fs->mount(QStringLiteral("/archive"));
+        fs->addFile(QStringLiteral("/downloads/a.mp4"), 100);
+        fs->injectError(MemoryFileSystem::Op::Remove,
+                        QStringLiteral("/downloads/a.mp4"), EACCES);
+
+        const Sorted sorted = sort(fs, QStringLiteral("/archive"));
+        QVERIFY(sorted.moved.isEmpty());
+        QVERIFY(fs->exists(QStringLiteral("/downloads/a.mp4")));
+        QVERIFY(
+            !fs->exists(QStringLiteral("/archive/Downloaded Videos/a.mp4")));
+    }
+
+    void failedMoveDoesNotStopOthers() {
+        auto fs = std::make_shared<MemoryFileSystem>();
+        for (int i = 0; i < 20; ++i)
+            fs->addFile(QStringLiteral("/downloads/%1.mp4").arg(i), 10);
+        fs->injectError(MemoryFileSystem::Op::Rename,
+                        QStringLiteral("/downloads/7.mp4"), EACCES);
+
+        const Sorted sorted = sort(fs);
+        QCOMPARE(sorted.moved.size(), 19);
+        QVERIFY(!sorted.moved.contains(QStringLiteral("/downloads/7.mp4")));
+        QVERIFY(fs->exists(QStringLiteral("/downloads/7.mp4")));
+        QVERIFY(
+            !fs->exists(QStringLiteral("/downloads/Downloaded Videos/7.mp4")));
+    }
+
+    void progressNeverGoesBack() {
+        auto fs = std::make_shared<MemoryFileSystem>();
+        fs->setLatency(MemoryFileSystem::Op::Rename, 200);
+        for (int i = 0; i < 200; ++i)
+            fs->addFile(QStringLiteral("/downloads/%1.mp4").arg(i), 10);
+
+        const Sorted sorted = sort(fs);
+        QVERIFY(std::is_sorted(sorted.progress.begin(),
+                               sorted.progress.end()));
+        QCOMPARE(sorted.progress.last(), 200);
+    }
+};
+
+QTEST_GUILESS_MAIN(MoveSchedulerTest)
+#include "MoveSchedulerTest.moc"